@@ -0,0 +1,91 @@
+#include <utility>
+
+#include "apng.h"
+
+
+namespace png_decoder::apng {
+
+Compositor::Compositor(uint32_t width, uint32_t height)
+    // canvas starts fully transparent black
+    : m_canvas(height, width)
+    , m_previous{}
+    , m_first{true} {}
+
+
+Image Compositor::compose(const Frame& frame) {
+    const FrameControl& control = frame.control;
+    // first frame has nothing to revert to, its area is cleared instead
+    DisposeOp disposeOp = control.disposeOp;
+    if (m_first && disposeOp == DisposeOp::Previous) {
+        disposeOp = DisposeOp::Background;
+    }
+    m_first = false;
+
+    if (disposeOp == DisposeOp::Previous) {
+        m_previous = m_canvas;
+    }
+
+    blend(frame);
+    Image result = m_canvas;
+
+    if (disposeOp == DisposeOp::Background) {
+        clear(control);
+    }
+    else if (disposeOp == DisposeOp::Previous) {
+        m_canvas = std::move(*m_previous);
+        m_previous.reset();
+    }
+
+    return result;
+}
+
+
+// frame regions are validated against the canvas when the fcTL chunk is read
+void Compositor::blend(const Frame& frame) {
+    const FrameControl& control = frame.control;
+
+    for (uint32_t row = 0; row < control.height; ++row) {
+        for (uint32_t col = 0; col < control.width; ++col) {
+            const RGB& source = frame.image(row, col);
+            RGB& destination = m_canvas(control.yOffset + row, control.xOffset + col);
+            destination = (control.blendOp == BlendOp::Source) ? source : blendOver(source, destination);
+        }
+    }
+}
+
+
+void Compositor::clear(const FrameControl& control) {
+    for (uint32_t row = 0; row < control.height; ++row) {
+        for (uint32_t col = 0; col < control.width; ++col) {
+            m_canvas(control.yOffset + row, control.xOffset + col) = RGB{};
+        }
+    }
+}
+
+
+// `over` operator of the APNG specification on straight (not premultiplied) 8-bit samples
+RGB Compositor::blendOver(const RGB& source, const RGB& destination) {
+    if (source.a == 255) {
+        return source;
+    }
+    if (source.a == 0) {
+        return destination;
+    }
+
+    // alpha and colors scaled by 255
+    const int destinationAlpha = destination.a * (255 - source.a);
+    const int alpha = source.a * 255 + destinationAlpha;
+
+    auto channel = [&](int sourceColor, int destinationColor) {
+        return (sourceColor * source.a * 255 + destinationColor * destinationAlpha + alpha / 2) / alpha;
+    };
+
+    RGB result{};
+    result.r = channel(source.r, destination.r);
+    result.g = channel(source.g, destination.g);
+    result.b = channel(source.b, destination.b);
+    result.a = (alpha + 127) / 255;
+    return result;
+}
+
+} // namespace png_decoder::apng
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "image.h"
+
+
+namespace png_decoder::apng {
+
+// See: https://wiki.mozilla.org/APNG_Specification
+
+// how the frame area of the canvas is treated before rendering the next frame
+enum class DisposeOp : uint8_t {
+    // left as is
+    None = 0,
+    // cleared to fully transparent black
+    Background,
+    // reverted to the contents before rendering the frame
+    Previous,
+};
+
+// how the frame is written onto the canvas
+enum class BlendOp : uint8_t {
+    // replaces the frame area, including alpha
+    Source = 0,
+    // alpha composited over the frame area
+    Over,
+};
+
+// content of acTL chunk
+struct AnimationControl {
+    uint32_t framesCount = 0;
+    // 0 means looping forever
+    uint32_t playsCount = 0;
+};
+
+// content of fcTL chunk without the sequence number
+struct FrameControl {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t xOffset = 0;
+    uint32_t yOffset = 0;
+    // frame delay is delayNumerator / delayDenominator seconds, denominator 0 means 1/100
+    uint16_t delayNumerator = 0;
+    uint16_t delayDenominator = 0;
+    DisposeOp disposeOp = DisposeOp::None;
+    BlendOp blendOp = BlendOp::Source;
+};
+
+// decoded frame region, placed at the offsets of its control on the canvas
+struct Frame {
+    FrameControl control;
+    Image image;
+};
+
+
+/*
+* Renders frames onto the animation canvas in playback order, applying their dispose and blend operations.
+* This is the only serial part of decoding an animation: frames themselves do not depend on each other.
+*/
+class Compositor {
+public:
+    Compositor(uint32_t width, uint32_t height);
+
+    /* renders the frame and returns the canvas to be displayed for it, then disposes the frame area */
+    Image compose(const Frame& frame);
+
+private:
+    void blend(const Frame& frame);
+    void clear(const FrameControl& control);
+
+    static RGB blendOver(const RGB& source, const RGB& destination);
+
+private:
+    Image m_canvas;
+    // canvas before the last frame rendered with `DisposeOp::Previous`
+    std::optional<Image> m_previous;
+    bool m_first;
+};
+
+} // namespace png_decoder::apng
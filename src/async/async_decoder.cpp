@@ -0,0 +1,211 @@
+#include <memory>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "async_decoder.h"
+#include "png_decoder.h"
+#include "exceptions/exceptions.h"
+#include "utils/memory_stream.h"
+
+
+namespace png_decoder::async {
+
+AsyncDecoder::AsyncDecoder(size_t workersCount, size_t prefetchDepth)
+    : m_prefetchDepth{prefetchDepth}
+    , m_maxLoaded{2 * std::max<size_t>(1, workersCount)}
+    , m_mutex{}
+    , m_queueCondition{}
+    , m_loadedCondition{}
+    , m_queue{}
+    , m_loaded{0}
+    , m_stopped{false}
+    , m_failedCompletions{0}
+    , m_workers(workersCount)
+    , m_ioThread{}
+    {
+        m_ioThread = std::thread([this]() { serveIO(); });
+    }
+
+AsyncDecoder::~AsyncDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_queueCondition.notify_all();
+    m_ioThread.join();
+    // workers are joined by the pool destructor after finishing the queued decodes
+}
+
+
+std::future<Image> AsyncDecoder::submit(std::string path) {
+    Request request{};
+    request.path = std::move(path);
+    std::future<Image> future = request.promise.get_future();
+
+    enqueue(std::move(request));
+    return future;
+}
+
+void AsyncDecoder::submit(std::string path, Completion completion) {
+    Request request{};
+    request.path = std::move(path);
+    request.completion = std::move(completion);
+
+    enqueue(std::move(request));
+}
+
+
+size_t AsyncDecoder::failedCompletions() const noexcept {
+    return m_failedCompletions.load(std::memory_order_relaxed);
+}
+
+
+void AsyncDecoder::enqueue(Request request) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(request));
+    }
+    m_queueCondition.notify_one();
+}
+
+
+void AsyncDecoder::serveIO() {
+    // requests owned by the I/O thread, so that the syscalls are made without holding the lock
+    std::deque<Request> pending;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queueCondition.wait(lock, [&]() { return m_stopped || !m_queue.empty() || !pending.empty(); });
+
+            while (!m_queue.empty()) {
+                pending.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+            if (pending.empty()) {
+                return;
+            }
+
+            // backpressure: not loading more files than the workers are able to take
+            m_loadedCondition.wait(lock, [this]() { return m_loaded < m_maxLoaded; });
+            ++m_loaded;
+        }
+
+        struct Job {
+            Request request;
+            std::vector<char> bytes;
+            bool loaded = false;
+        };
+        auto job = std::make_shared<Job>();
+        job->request = std::move(pending.front());
+        pending.pop_front();
+
+        prefetch(pending);
+
+        try {
+            job->bytes = readFile(job->request);
+            job->loaded = true;
+        }
+        catch (...) {
+            job->request.promise.set_exception(std::current_exception());
+        }
+
+        m_workers.submit([this, job]() {
+            // the slot is released however the task ends, otherwise the I/O thread would wait for it forever
+            struct LoadedSlot {
+                AsyncDecoder& decoder;
+                ~LoadedSlot() { decoder.releaseLoaded(); }
+            } slot{*this};
+
+            if (job->loaded) {
+                decode(job->request, job->bytes);
+            }
+            job->bytes = {};
+            complete(job->request);
+        });
+    }
+}
+
+
+void AsyncDecoder::prefetch(std::deque<Request>& queue) const {
+    for (size_t i = 0; i < std::min(m_prefetchDepth, queue.size()); ++i) {
+        Request& request = queue[i];
+        if (request.fd != -1) {
+            continue;
+        }
+
+        request.fd = ::open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (request.fd != -1) {
+            static_cast<void>(::posix_fadvise(request.fd, 0, 0, POSIX_FADV_WILLNEED));
+        }
+    }
+}
+
+
+std::vector<char> AsyncDecoder::readFile(Request& request) {
+    int fd = request.fd != -1 ? request.fd : ::open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+    request.fd = -1;
+
+    if (fd == -1) {
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Cannot open file " + request.path));
+    }
+
+    struct stat status{};
+    if (::fstat(fd, &status) != 0) {
+        ::close(fd);
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Cannot stat file " + request.path));
+    }
+
+    std::vector<char> bytes(status.st_size);
+    size_t offset = 0;
+    while (offset < bytes.size()) {
+        ssize_t count = ::pread(fd, bytes.data() + offset, bytes.size() - offset, offset);
+        if (count <= 0) {
+            ::close(fd);
+            throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Cannot read file " + request.path));
+        }
+        offset += count;
+    }
+
+    ::close(fd);
+    return bytes;
+}
+
+
+void AsyncDecoder::decode(Request& request, const std::vector<char>& bytes) {
+    try {
+        utils::MemoryInputStream stream(bytes.data(), bytes.size());
+        PNGDecoder decoder(stream);
+        request.promise.set_value(decoder.createImage());
+    }
+    catch (...) {
+        request.promise.set_exception(std::current_exception());
+    }
+}
+
+
+// an exception escaping a pool task would terminate the process
+void AsyncDecoder::complete(Request& request) {
+    if (!request.completion) {
+        return;
+    }
+    try {
+        request.completion(request.promise.get_future());
+    }
+    catch (...) {
+        m_failedCompletions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+void AsyncDecoder::releaseLoaded() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_loaded;
+    }
+    m_loadedCondition.notify_one();
+}
+
+
+} // namespace png_decoder::async
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread-pool/thread_pool.h"
+#include "image.h"
+
+
+namespace png_decoder::async {
+
+/*
+* Non-blocking decoding of files.
+*
+* Requests are served in two stages: a single I/O thread reads files with `pread`, hinting the kernel
+* with `posix_fadvise(POSIX_FADV_WILLNEED)` about the next `prefetchDepth` queued files, and a pool of
+* workers decodes the loaded bytes. `submit` never touches the disk and returns immediately.
+* The number of loaded, not yet decoded files is bounded to keep memory in check.
+*
+* Destructor completes every submitted request before returning.
+*/
+class AsyncDecoder {
+public:
+    /*
+    * Invoked on a worker thread with a ready future; `get()` rethrows decoding errors.
+    * Completions should not throw: an exception escaping one is caught and dropped, see `failedCompletions`.
+    */
+    using Completion = std::function<void(std::future<Image>)>;
+
+    explicit AsyncDecoder(size_t workersCount = std::thread::hardware_concurrency(),
+                          size_t prefetchDepth = DEFAULT_PREFETCH_DEPTH);
+    ~AsyncDecoder();
+
+    AsyncDecoder(const AsyncDecoder&) = delete;
+    AsyncDecoder& operator=(const AsyncDecoder&) = delete;
+
+    std::future<Image> submit(std::string path);
+    void submit(std::string path, Completion completion);
+    /* completions that threw so far */
+    size_t failedCompletions() const noexcept;
+
+private:
+    struct Request {
+        std::string path;
+        std::promise<Image> promise;
+        Completion completion;
+        // opened during prefetch, -1 otherwise
+        int fd = -1;
+    };
+
+    void enqueue(Request request);
+    void serveIO();
+    void prefetch(std::deque<Request>& queue) const;
+    static std::vector<char> readFile(Request& request);
+    static void decode(Request& request, const std::vector<char>& bytes);
+    void complete(Request& request);
+    void releaseLoaded();
+
+private:
+    static constexpr size_t DEFAULT_PREFETCH_DEPTH = 4;
+
+private:
+    const size_t m_prefetchDepth;
+    const size_t m_maxLoaded;
+
+    std::mutex m_mutex;
+    std::condition_variable m_queueCondition;
+    std::condition_variable m_loadedCondition;
+    std::deque<Request> m_queue;
+    size_t m_loaded;
+    bool m_stopped;
+    std::atomic<size_t> m_failedCompletions;
+
+    thread_pool::ThreadPool m_workers;
+    std::thread m_ioThread;
+};
+
+
+} // namespace png_decoder::async
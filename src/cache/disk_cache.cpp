@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "disk_cache.h"
+#include "png_decoder.h"
+#include "exceptions/exceptions.h"
+#include "utils/hash.h"
+#include "utils/memory_stream.h"
+
+
+namespace png_decoder::cache {
+
+namespace {
+
+/*
+* Entry file layout (host byte order, entries are not meant to be moved between machines):
+*   header page: EntryHeader, zero padded up to `dataOffset`,
+*   `height` rows of `stride` bytes starting at `dataOffset`, a multiple of the page size.
+*/
+constexpr char MAGIC[8] = {'P', 'N', 'G', 'P', 'I', 'X', '\r', '\n'};
+constexpr uint32_t VERSION = 2;
+// read back as a different value on a host of the other endianness
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr uint64_t DATA_OFFSET = 4096;
+
+struct EntryHeader {
+    char magic[8];
+    uint32_t byteOrderMark;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint64_t stride;
+    uint64_t dataOffset;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint32_t pixelSize;
+    uint8_t channelOrder;
+    uint8_t alphaMode;
+    uint8_t sampleType;
+    uint8_t transferFunction;
+    // `DecodeOptions` the pixels were oriented with, the dimensions are those of the upright image
+    uint8_t orientation;
+    uint8_t useExifOrientation;
+};
+static_assert(std::is_trivially_copyable_v<EntryHeader>);
+static_assert(sizeof(EntryHeader) <= DATA_OFFSET);
+
+
+std::string systemError(const std::string& action, const std::string& path) {
+    return action + " " + path + ": " + std::strerror(errno);
+}
+
+// read-only mapping of a whole file, unmapped and closed on destruction
+class FileMapping {
+public:
+    explicit FileMapping(const std::string& path) : m_address{nullptr}, m_size{0} {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot open", path)));
+        }
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot stat", path)));
+        }
+
+        m_size = info.st_size;
+        if (m_size > 0) {
+            m_address = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+
+        if (m_address == MAP_FAILED) {
+            throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot map", path)));
+        }
+    }
+
+    ~FileMapping() {
+        if (m_address != nullptr) {
+            ::munmap(m_address, m_size);
+        }
+    }
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    const void* data() const {
+        return m_address;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+private:
+    void* m_address;
+    size_t m_size;
+};
+
+} // namespace
+
+
+// MappedImage
+MappedImage::MappedImage(void* address, size_t size, const image_view::ImageView& view, const PixelFormat& format,
+                         uint64_t sourceHash)
+    : m_address{address}
+    , m_size{size}
+    , m_view{view}
+    , m_format{format}
+    , m_sourceHash{sourceHash} {}
+
+MappedImage::~MappedImage() {
+    unmap();
+}
+
+MappedImage::MappedImage(MappedImage&& other) noexcept
+    : m_address{std::exchange(other.m_address, nullptr)}
+    , m_size{std::exchange(other.m_size, 0)}
+    , m_view{std::exchange(other.m_view, {})}
+    , m_format{other.m_format}
+    , m_sourceHash{other.m_sourceHash} {}
+
+MappedImage& MappedImage::operator=(MappedImage&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_address = std::exchange(other.m_address, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_view = std::exchange(other.m_view, {});
+        m_format = other.m_format;
+        m_sourceHash = other.m_sourceHash;
+    }
+    return *this;
+}
+
+const image_view::ImageView& MappedImage::view() const noexcept {
+    return m_view;
+}
+
+const PixelFormat& MappedImage::format() const noexcept {
+    return m_format;
+}
+
+uint64_t MappedImage::sourceHash() const noexcept {
+    return m_sourceHash;
+}
+
+MappedImage::operator bool() const noexcept {
+    return m_address != nullptr;
+}
+
+void MappedImage::unmap() noexcept {
+    if (m_address != nullptr) {
+        ::munmap(m_address, m_size);
+        m_address = nullptr;
+    }
+}
+
+
+// DiskCache
+DiskCache::DiskCache(std::string directory, DiskCacheOptions options)
+    : m_directory{std::move(directory)}
+    , m_options{std::move(options)}
+    , m_storesCount{0}
+    {
+        const size_t alignment = m_options.rowAlignment;
+        // rows have to stay aligned relative to the page-aligned start of the pixel data
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0 || DATA_OFFSET % alignment != 0) {
+            throw exceptions::CacheException(PNG_DECODER_ERROR_MESSAGE(
+                "Row alignment must be a power of two not greater than " + std::to_string(DATA_OFFSET) +
+                ": " + std::to_string(alignment)));
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(m_directory, error);
+        if (error) {
+            throw exceptions::CacheException(PNG_DECODER_ERROR_MESSAGE(
+                "Cannot create cache directory " + m_directory + ": " + error.message()));
+        }
+    }
+
+
+MappedImage DiskCache::get(const std::string& path) {
+    FileMapping source(path);
+    return get(source.data(), source.size());
+}
+
+
+MappedImage DiskCache::get(const void* data, size_t size) {
+    const uint64_t sourceHash = utils::xxHash64(data, size);
+
+    MappedImage image = load(entryPath(sourceHash), size, sourceHash);
+    if (image) {
+        return image;
+    }
+    return store(data, size, sourceHash);
+}
+
+
+MappedImage DiskCache::find(const void* data, size_t size) const {
+    const uint64_t sourceHash = utils::xxHash64(data, size);
+    return load(entryPath(sourceHash), size, sourceHash);
+}
+
+
+std::string DiskCache::entryPath(uint64_t sourceHash) const {
+    const DecodeOptions& options = m_options.decodeOptions;
+    const PixelFormat& format = options.pixelFormat;
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx-%u%u%u%u-%u%u-%zu.pix", static_cast<unsigned long long>(sourceHash),
+                  static_cast<unsigned>(format.channelOrder), static_cast<unsigned>(format.alphaMode),
+                  static_cast<unsigned>(format.sampleType), static_cast<unsigned>(format.transferFunction),
+                  static_cast<unsigned>(options.orientation), static_cast<unsigned>(options.useExifOrientation),
+                  m_options.rowAlignment);
+    return m_directory + "/" + name;
+}
+
+
+MappedImage DiskCache::store(const void* data, size_t size, uint64_t sourceHash) {
+    utils::MemoryInputStream stream(static_cast<const char*>(data), size);
+    PNGDecoder decoder(stream, m_options.decodeOptions);
+
+    const IHDR& ihdr = decoder.getIHDR();
+    // pixels are stored upright, so a transposing orientation swaps the dimensions
+    const uint32_t width = orientedWidth(decoder.getOrientation(), ihdr.width, ihdr.height);
+    const uint32_t height = orientedHeight(decoder.getOrientation(), ihdr.width, ihdr.height);
+    const PixelFormat& format = m_options.decodeOptions.pixelFormat;
+    const size_t pixelSize = packedPixelSize(format);
+    const size_t stride = image_view::ImageBuffer::alignedStride(width, pixelSize, m_options.rowAlignment);
+    const size_t fileSize = DATA_OFFSET + stride * height;
+
+    const std::string entry = entryPath(sourceHash);
+    const std::string temporary = entry + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(m_storesCount++);
+
+    int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        throw exceptions::CacheException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot create", temporary)));
+    }
+
+    void* address = MAP_FAILED;
+    try {
+        // unlike ftruncate, running out of disk space is reported here rather than by SIGBUS while decoding
+        if (const int error = ::posix_fallocate(fd, 0, fileSize); error != 0) {
+            errno = error;
+            throw exceptions::CacheException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot allocate", temporary)));
+        }
+
+        address = ::mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            throw exceptions::CacheException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot map", temporary)));
+        }
+
+        unsigned char* base = static_cast<unsigned char*>(address);
+        decoder.decode(image_view::ImageView(base + DATA_OFFSET, width, height, stride, pixelSize));
+
+        EntryHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.byteOrderMark = BYTE_ORDER_MARK;
+        header.version = VERSION;
+        header.width = width;
+        header.height = height;
+        header.stride = stride;
+        header.dataOffset = DATA_OFFSET;
+        header.sourceSize = size;
+        header.sourceHash = sourceHash;
+        header.pixelSize = pixelSize;
+        header.channelOrder = static_cast<uint8_t>(format.channelOrder);
+        header.alphaMode = static_cast<uint8_t>(format.alphaMode);
+        header.sampleType = static_cast<uint8_t>(format.sampleType);
+        header.transferFunction = static_cast<uint8_t>(format.transferFunction);
+        header.orientation = static_cast<uint8_t>(m_options.decodeOptions.orientation);
+        header.useExifOrientation = m_options.decodeOptions.useExifOrientation;
+        std::memcpy(base, &header, sizeof(header));
+
+        ::munmap(address, fileSize);
+        address = MAP_FAILED;
+        ::close(fd);
+        fd = -1;
+
+        // replaces a stale or concurrently stored entry, readers keep their mappings of the old file
+        if (::rename(temporary.c_str(), entry.c_str()) != 0) {
+            throw exceptions::CacheException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot rename", temporary)));
+        }
+    }
+    catch (...) {
+        if (address != MAP_FAILED) {
+            ::munmap(address, fileSize);
+        }
+        if (fd != -1) {
+            ::close(fd);
+        }
+        ::unlink(temporary.c_str());
+        throw;
+    }
+
+    MappedImage image = load(entry, size, sourceHash);
+    if (!image) {
+        throw exceptions::CacheException(PNG_DECODER_ERROR_MESSAGE("Stored cache entry is invalid: " + entry));
+    }
+    return image;
+}
+
+
+MappedImage DiskCache::load(const std::string& entry, size_t sourceSize, uint64_t sourceHash) const {
+    const int fd = ::open(entry.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return {};
+    }
+
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < DATA_OFFSET) {
+        ::close(fd);
+        return {};
+    }
+
+    const size_t fileSize = info.st_size;
+    // private writable mapping: callers may modify their pixels without touching the entry
+    void* address = ::mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return {};
+    }
+
+    EntryHeader header{};
+    std::memcpy(&header, address, sizeof(header));
+
+    const DecodeOptions& options = m_options.decodeOptions;
+    const PixelFormat& format = options.pixelFormat;
+    const bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                       header.byteOrderMark == BYTE_ORDER_MARK &&
+                       header.version == VERSION &&
+                       header.sourceSize == sourceSize &&
+                       header.sourceHash == sourceHash &&
+                       header.channelOrder == static_cast<uint8_t>(format.channelOrder) &&
+                       header.alphaMode == static_cast<uint8_t>(format.alphaMode) &&
+                       header.sampleType == static_cast<uint8_t>(format.sampleType) &&
+                       header.transferFunction == static_cast<uint8_t>(format.transferFunction) &&
+                       header.pixelSize == packedPixelSize(format) &&
+                       header.orientation == static_cast<uint8_t>(options.orientation) &&
+                       header.useExifOrientation == static_cast<uint8_t>(options.useExifOrientation) &&
+                       header.dataOffset == DATA_OFFSET &&
+                       header.stride >= static_cast<uint64_t>(header.width) * header.pixelSize &&
+                       header.stride % m_options.rowAlignment == 0 &&
+                       // checked before multiplying, so that a corrupted header cannot overflow the size
+                       header.height <= (fileSize - DATA_OFFSET) / std::max<uint64_t>(1, header.stride) &&
+                       DATA_OFFSET + header.stride * header.height == fileSize;
+    if (!valid) {
+        ::munmap(address, fileSize);
+        return {};
+    }
+
+    unsigned char* pixels = static_cast<unsigned char*>(address) + header.dataOffset;
+    image_view::ImageView view(pixels, header.width, header.height, header.stride, header.pixelSize);
+    return MappedImage(address, fileSize, view, format, sourceHash);
+}
+
+
+} // namespace png_decoder::cache
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "image-view/image_view.h"
+#include "misc/options.h"
+#include "misc/pixel_format.h"
+
+
+namespace png_decoder::cache {
+
+struct DiskCacheOptions {
+    /*
+    * `pixelFormat` of the options is the format of the stored pixels, entries of other formats are not used;
+    * pixels are stored upright (`orientation`, `useExifOrientation`)
+    */
+    DecodeOptions decodeOptions{};
+    // every stored row starts at this boundary (a power of two)
+    size_t rowAlignment = image_view::ImageBuffer::DEFAULT_ALIGNMENT;
+};
+
+
+/*
+* Decoded pixels of a cache entry mapped into memory. Pages are loaded by the kernel on first access
+* and shared with every other process mapping the same entry. The mapping is private:
+* writes through the view are allowed but never reach the file.
+*/
+class MappedImage {
+public:
+    MappedImage() = default;
+    ~MappedImage();
+
+    MappedImage(MappedImage&& other) noexcept;
+    MappedImage& operator=(MappedImage&& other) noexcept;
+    MappedImage(const MappedImage&) = delete;
+    MappedImage& operator=(const MappedImage&) = delete;
+
+    // empty if the image is not mapped
+    const image_view::ImageView& view() const noexcept;
+    const PixelFormat& format() const noexcept;
+    // XXH64 of the PNG file the pixels were decoded from
+    uint64_t sourceHash() const noexcept;
+
+    explicit operator bool() const noexcept;
+
+private:
+    friend class DiskCache;
+
+    MappedImage(void* address, size_t size, const image_view::ImageView& view, const PixelFormat& format, uint64_t sourceHash);
+    void unmap() noexcept;
+
+private:
+    void* m_address = nullptr;
+    size_t m_size = 0;
+    image_view::ImageView m_view{};
+    PixelFormat m_format{};
+    uint64_t m_sourceHash = 0;
+};
+
+
+/*
+* Persistent cache of decoded pixels in a directory, surviving process restarts.
+*
+* Entries are addressed by XXH64 of the PNG file, the pixel format and the orientation options, so a modified file
+* never hits a stale entry and identical files share one entry. Every entry is a single file: a versioned header page
+* (dimensions, format, orientation, stride, source size and hash) followed by page-aligned rows, so a hit costs hashing
+* the (compressed) source and one `mmap`. Entries are decoded into a temporary file with the regular `PNGDecoder` path and published
+* with an atomic rename, so concurrent processes never observe a partially written entry.
+* Entries of modified or deleted sources are not removed, the directory has to be cleaned up externally.
+*/
+class DiskCache {
+public:
+    explicit DiskCache(std::string directory, DiskCacheOptions options = {});
+
+    /* maps the cached pixels of the file, decoding and storing them first if there is no valid entry */
+    MappedImage get(const std::string& path);
+    /* same for a PNG image in memory */
+    MappedImage get(const void* data, size_t size);
+    /* never decodes, returns an empty image if there is no valid entry */
+    MappedImage find(const void* data, size_t size) const;
+
+    std::string entryPath(uint64_t sourceHash) const;
+
+private:
+    MappedImage store(const void* data, size_t size, uint64_t sourceHash);
+    MappedImage load(const std::string& entry, size_t sourceSize, uint64_t sourceHash) const;
+
+private:
+    std::string m_directory;
+    DiskCacheOptions m_options;
+    // distinguishes temporary files of concurrent stores within the process
+    std::atomic<uint64_t> m_storesCount;
+};
+
+
+} // namespace png_decoder::cache
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sys/stat.h>
+
+#include "image_cache.h"
+#include "png_decoder.h"
+#include "exceptions/exceptions.h"
+#include "utils/hash.h"
+
+
+namespace png_decoder::cache {
+
+ImageCache::ImageCache(CacheOptions options)
+    : m_options{std::move(options)}
+    , m_shards{}
+    , m_bytes{0}
+    , m_clock{0}
+    , m_hits{0}
+    , m_misses{0}
+    , m_sharedMisses{0}
+    , m_evictions{0}
+    , m_rejected{0}
+    {
+        const size_t shardsCount = std::max<size_t>(1, m_options.shardsCount);
+        for (size_t i = 0; i < shardsCount; ++i) {
+            m_shards.push_back(std::make_unique<Shard>());
+        }
+    }
+
+
+ImageHandle ImageCache::get(const std::string& path) {
+    return get(fileKey(path), [&]() {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Cannot open " + path));
+        }
+        PNGDecoder decoder(file, m_options.decodeOptions);
+        return decoder.createImage();
+    });
+}
+
+
+ImageHandle ImageCache::get(const std::string& key, const Decode& decode) {
+    Shard& shard = shardFor(key);
+
+    std::promise<ImageHandle> promise;
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            ++m_hits;
+            return touch(shard, it->second);
+        }
+
+        auto inflight = shard.inflight.find(key);
+        if (inflight != shard.inflight.end()) {
+            std::shared_future<ImageHandle> result = inflight->second;
+            lock.unlock();
+            ++m_sharedMisses;
+            return result.get();
+        }
+
+        shard.inflight.emplace(key, promise.get_future().share());
+    }
+    ++m_misses;
+
+    ImageHandle image;
+    try {
+        image = std::make_shared<const Image>(decode());
+    }
+    catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.inflight.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.inflight.erase(key);
+        insert(shard, key, image);
+    }
+    promise.set_value(image);
+    evictOverCapacity();
+    return image;
+}
+
+
+ImageHandle ImageCache::find(const std::string& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        return nullptr;
+    }
+    ++m_hits;
+    return touch(shard, it->second);
+}
+
+
+void ImageCache::erase(const std::string& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        m_bytes -= it->second->bytes;
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+
+void ImageCache::clear() {
+    for (const auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        for (const auto& entry : shard->entries) {
+            m_bytes -= entry.bytes;
+        }
+        shard->entries.clear();
+        shard->index.clear();
+    }
+}
+
+
+CacheStats ImageCache::stats() const {
+    CacheStats stats{};
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.sharedMisses = m_sharedMisses;
+    stats.evictions = m_evictions;
+    stats.rejected = m_rejected;
+    stats.bytes = m_bytes;
+
+    for (const auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.entriesCount += shard->entries.size();
+    }
+    return stats;
+}
+
+
+std::string ImageCache::fileKey(const std::string& path) {
+    struct stat info{};
+    if (::stat(path.c_str(), &info) != 0) {
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Cannot stat " + path));
+    }
+
+    // '\0' cannot appear in paths, so keys of different files never collide
+    return path + '\0' + std::to_string(info.st_mtim.tv_sec) + '.' + std::to_string(info.st_mtim.tv_nsec) +
+           '\0' + std::to_string(info.st_size);
+}
+
+
+std::string ImageCache::contentKey(const void* data, size_t size) {
+    char key[sizeof("xxh64:") + 16];
+    std::snprintf(key, sizeof(key), "xxh64:%016llx",
+                  static_cast<unsigned long long>(utils::xxHash64(data, size)));
+    return key;
+}
+
+
+size_t ImageCache::imageBytes(const Image& image) {
+    return sizeof(Image) + sizeof(RGB) * static_cast<size_t>(image.Width()) * image.Height();
+}
+
+
+ImageCache::Shard& ImageCache::shardFor(const std::string& key) const {
+    return *m_shards[std::hash<std::string>{}(key) % m_shards.size()];
+}
+
+
+// moves the entry to the front of LRU list, must be called with the shard lock held
+ImageHandle ImageCache::touch(Shard& shard, std::list<Entry>::iterator entry) {
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    entry->lastUse = ++m_clock;
+    return entry->image;
+}
+
+
+// must be called with the shard lock held, the caller evicts what gets over the capacity after releasing it
+void ImageCache::insert(Shard& shard, const std::string& key, const ImageHandle& image) {
+    const size_t bytes = imageBytes(*image);
+    // an image larger than the whole cache would evict everything and still not fit
+    if (bytes > m_options.capacityBytes) {
+        ++m_rejected;
+        return;
+    }
+    if (shard.index.count(key) > 0) {
+        return;
+    }
+
+    shard.entries.push_front(Entry{key, image, bytes, ++m_clock});
+    shard.index.emplace(key, shard.entries.begin());
+    m_bytes += bytes;
+}
+
+
+/*
+* Evicts the least recently used entries of all shards until the cache fits its capacity.
+* Only one shard is locked at a time, so shards never wait for each other in a fixed order:
+* the oldest tail is found first, and evicted only if it is still the tail once its shard is locked again.
+*/
+void ImageCache::evictOverCapacity() {
+    while (m_bytes > m_options.capacityBytes) {
+        Shard* oldest = nullptr;
+        uint64_t oldestUse = std::numeric_limits<uint64_t>::max();
+        for (const auto& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            if (!shard->entries.empty() && shard->entries.back().lastUse < oldestUse) {
+                oldest = shard.get();
+                oldestUse = shard->entries.back().lastUse;
+            }
+        }
+        if (oldest == nullptr) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(oldest->mutex);
+        if (!oldest->entries.empty() && oldest->entries.back().lastUse == oldestUse) {
+            const Entry& victim = oldest->entries.back();
+            m_bytes -= victim.bytes;
+            oldest->index.erase(victim.key);
+            oldest->entries.pop_back();
+            ++m_evictions;
+        }
+    }
+}
+
+
+} // namespace png_decoder::cache
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "misc/options.h"
+#include "image.h"
+
+
+namespace png_decoder::cache {
+
+// decoded images are shared between all users of the cache and never modified
+using ImageHandle = std::shared_ptr<const Image>;
+
+struct CacheOptions {
+    // memory taken by cached pixels of all shards, e.g. 16 images of a megapixel (16 MiB each as `Image`)
+    size_t capacityBytes = size_t(256) << 20;
+    // lock stripes; lookups of keys in different shards never wait for each other
+    size_t shardsCount = 16;
+    DecodeOptions decodeOptions{};
+};
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // lookups that waited for a decode started by another thread
+    uint64_t sharedMisses = 0;
+    uint64_t evictions = 0;
+    // decoded images larger than the whole capacity, returned but never cached
+    uint64_t rejected = 0;
+    size_t entriesCount = 0;
+    size_t bytes = 0;
+};
+
+
+/*
+* Concurrent LRU cache of decoded images.
+*
+* Keys are hashed into independently locked shards sharing one byte budget: when the cache gets over it,
+* the least recently used images of all shards are evicted, locking one shard at a time. Only an image
+* larger than the whole budget is not cached (`CacheStats::rejected`). When several threads miss the same key at once
+* only the first one decodes it ("single flight"), the others wait for its result; decoding itself
+* runs without holding the shard lock. Failed decodes are not cached, every waiter gets the exception.
+*/
+class ImageCache {
+public:
+    using Decode = std::function<Image()>;
+
+    explicit ImageCache(CacheOptions options = {});
+
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    /* decodes the file on miss, the key includes its mtime and size, so modified files are decoded again */
+    ImageHandle get(const std::string& path);
+    /* calls `decode` on miss */
+    ImageHandle get(const std::string& key, const Decode& decode);
+    /* never decodes, returns null on miss */
+    ImageHandle find(const std::string& key);
+
+    void erase(const std::string& key);
+    void clear();
+    CacheStats stats() const;
+
+    // path with modification time and size of the file
+    static std::string fileKey(const std::string& path);
+    // XXH64 of the content, for images not backed by files
+    static std::string contentKey(const void* data, size_t size);
+    static size_t imageBytes(const Image& image);
+
+private:
+    struct Entry {
+        std::string key;
+        ImageHandle image;
+        size_t bytes;
+        // tick of `m_clock` at the last use, orders entries of different shards
+        uint64_t lastUse;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        // decodes in progress
+        std::unordered_map<std::string, std::shared_future<ImageHandle>> inflight;
+    };
+
+    Shard& shardFor(const std::string& key) const;
+    ImageHandle touch(Shard& shard, std::list<Entry>::iterator entry);
+    void insert(Shard& shard, const std::string& key, const ImageHandle& image);
+    void evictOverCapacity();
+
+private:
+    CacheOptions m_options;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    // bytes of all cached images
+    std::atomic<size_t> m_bytes;
+    std::atomic<uint64_t> m_clock;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_sharedMisses;
+    std::atomic<uint64_t> m_evictions;
+    std::atomic<uint64_t> m_rejected;
+};
+
+
+} // namespace png_decoder::cache
@@ -0,0 +1,120 @@
+#include <cmath>
+#include <cstring>
+
+#include "color_transform.h"
+
+
+namespace png_decoder::color {
+
+ColorTransform::ColorTransform(const ColorInfo& info, const PixelFormat& format)
+    : m_format{format}
+    , m_colorTable8{}
+    , m_alphaTable8{}
+    , m_colorTable16{}
+    , m_alphaTable16{}
+    , m_colorTableFloat{}
+    , m_alphaTableFloat{}
+    {
+        for (size_t sample = 0; sample < 256; ++sample) {
+            const double color = convertSample(sample, info, format.transferFunction);
+            const double alpha = sample / 255.0;
+
+            m_colorTable8[sample] = std::lround(color * 255.0);
+            m_alphaTable8[sample] = sample;
+            m_colorTable16[sample] = std::lround(color * 65535.0);
+            m_alphaTable16[sample] = sample * 257;
+            m_colorTableFloat[sample] = color;
+            m_alphaTableFloat[sample] = alpha;
+        }
+    }
+
+
+void ColorTransform::apply(const unsigned char* rgba, size_t count, unsigned char* out) const {
+    switch (m_format.sampleType) {
+    case SampleType::UInt8:
+        applyTables(rgba, count, m_colorTable8, m_alphaTable8, out);
+        break;
+    case SampleType::UInt16:
+        applyTables(rgba, count, m_colorTable16, m_alphaTable16, out);
+        break;
+    case SampleType::Float32:
+        applyTables(rgba, count, m_colorTableFloat, m_alphaTableFloat, out);
+        break;
+    case SampleType::PaletteIndex:
+        // indices are never transformed, the decoder creates no transform for them
+        break;
+    }
+}
+
+
+template <class T>
+void ColorTransform::applyTables(const unsigned char* rgba, size_t count, const std::array<T, 256>& colorTable,
+                                 const std::array<T, 256>& alphaTable, unsigned char* out) const {
+    const bool premultiplied = (m_format.alphaMode == AlphaMode::Premultiplied);
+
+    for (size_t i = 0; i < count; ++i, rgba += 4, out += 4 * sizeof(T)) {
+        T red = colorTable[rgba[0]];
+        T green = colorTable[rgba[1]];
+        T blue = colorTable[rgba[2]];
+        const T alpha = alphaTable[rgba[3]];
+
+        // premultiplying after the transfer function, i.e. in linear light for linear output
+        if (premultiplied) {
+            if constexpr (std::is_floating_point_v<T>) {
+                red *= alpha;
+                green *= alpha;
+                blue *= alpha;
+            }
+            else {
+                const uint32_t alphaByte = rgba[3];
+                red = (uint32_t(red) * alphaByte + 127) / 255;
+                green = (uint32_t(green) * alphaByte + 127) / 255;
+                blue = (uint32_t(blue) * alphaByte + 127) / 255;
+            }
+        }
+
+        T pixel[4];
+        switch (m_format.channelOrder) {
+        case ChannelOrder::RGBA: pixel[0] = red; pixel[1] = green; pixel[2] = blue; pixel[3] = alpha; break;
+        case ChannelOrder::BGRA: pixel[0] = blue; pixel[1] = green; pixel[2] = red; pixel[3] = alpha; break;
+        case ChannelOrder::ARGB: pixel[0] = alpha; pixel[1] = red; pixel[2] = green; pixel[3] = blue; break;
+        }
+        // output rows are not necessarily aligned for T
+        std::memcpy(out, pixel, sizeof(pixel));
+    }
+}
+
+
+double ColorTransform::convertSample(uint8_t sample, const ColorInfo& info, TransferFunction transferFunction) {
+    const double encoded = sample / 255.0;
+
+    switch (transferFunction) {
+    case TransferFunction::Encoded:
+        return encoded;
+    case TransferFunction::SRGB:
+        // already on the sRGB curve, avoiding rounding errors of the round trip
+        if (info.renderingIntent.has_value() || !info.gamma.has_value()) {
+            return encoded;
+        }
+        return encodeSRGB(decodeToLinear(encoded, info));
+    case TransferFunction::Linear:
+        return decodeToLinear(encoded, info);
+    }
+    return encoded;
+}
+
+
+double ColorTransform::decodeToLinear(double encoded, const ColorInfo& info) {
+    if (info.renderingIntent.has_value() || !info.gamma.has_value()) {
+        // sRGB EOTF, see: IEC 61966-2-1
+        return encoded <= 0.04045 ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4);
+    }
+    return std::pow(encoded, 1.0 / *info.gamma);
+}
+
+
+double ColorTransform::encodeSRGB(double linear) {
+    return linear <= 0.0031308 ? 12.92 * linear : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+}
+
+} // namespace png_decoder::color
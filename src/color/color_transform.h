@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+#include "misc/pixel_format.h"
+
+
+namespace png_decoder::color {
+
+// white point and primaries from cHRM chunk, CIE 1931 xy
+struct Chromaticities {
+    double whiteX = 0;
+    double whiteY = 0;
+    double redX = 0;
+    double redY = 0;
+    double greenX = 0;
+    double greenY = 0;
+    double blueX = 0;
+    double blueY = 0;
+};
+
+/*
+* Color space information of the image, see: http://www.libpng.org/pub/png/spec/1.2/PNG-Chunks.html#C.Ancillary-chunks
+* Every field is empty if the chunk is absent or invalid.
+*/
+struct ColorInfo {
+    // gAMA: encoded = linear ^ gamma
+    std::optional<double> gamma;
+    // sRGB: rendering intent, the chunk overrides gAMA and cHRM
+    std::optional<uint8_t> renderingIntent;
+    std::optional<Chromaticities> chromaticities;
+};
+
+
+/*
+* Converts straight 8-bit RGBA pixels into packed pixels of any `PixelFormat`.
+* The transfer function is applied through 256-entry tables (one for color channels, one for alpha)
+* precomputed for the image, so no `pow` is evaluated per pixel.
+* Images without gAMA and sRGB chunks are assumed to be sRGB. Primaries from cHRM are not converted.
+*/
+class ColorTransform {
+public:
+    ColorTransform(const ColorInfo& info, const PixelFormat& format);
+
+    void apply(const unsigned char* rgba, size_t count, unsigned char* out) const;
+
+private:
+    template <class T>
+    void applyTables(const unsigned char* rgba, size_t count, const std::array<T, 256>& colorTable,
+                     const std::array<T, 256>& alphaTable, unsigned char* out) const;
+
+    // maps encoded sample into [0, 1] value of the requested transfer function
+    static double convertSample(uint8_t sample, const ColorInfo& info, TransferFunction transferFunction);
+    static double decodeToLinear(double encoded, const ColorInfo& info);
+    static double encodeSRGB(double linear);
+
+private:
+    PixelFormat m_format;
+    std::array<uint8_t, 256> m_colorTable8;
+    std::array<uint8_t, 256> m_alphaTable8;
+    std::array<uint16_t, 256> m_colorTable16;
+    std::array<uint16_t, 256> m_alphaTable16;
+    std::array<float, 256> m_colorTableFloat;
+    std::array<float, 256> m_alphaTableFloat;
+};
+
+} // namespace png_decoder::color
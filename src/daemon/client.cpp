@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "client.h"
+#include "daemon/protocol.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder::daemon {
+
+namespace {
+
+std::string systemError(const std::string& action) {
+    return action + ": " + std::strerror(errno);
+}
+
+// closes the descriptor on destruction
+class Descriptor {
+public:
+    explicit Descriptor(int fd) : m_fd{fd} {}
+
+    ~Descriptor() {
+        if (m_fd != -1) {
+            ::close(m_fd);
+        }
+    }
+
+    Descriptor(const Descriptor&) = delete;
+    Descriptor& operator=(const Descriptor&) = delete;
+
+    int get() const {
+        return m_fd;
+    }
+
+private:
+    int m_fd;
+};
+
+// the daemon is trusted to decode, but a mismatching response must not make the client read past its mapping,
+// and pixels have to be sealed so that nobody holding the memfd can change them under the client
+bool validResponse(const Response& response, const PixelFormat& format, int pixels) {
+    struct stat info{};
+    return response.version == PROTOCOL_VERSION &&
+           pixels != -1 &&
+           ::fstat(pixels, &info) == 0 &&
+           (::fcntl(pixels, F_GET_SEALS) & F_SEAL_WRITE) != 0 &&
+           static_cast<uint64_t>(info.st_size) == response.size &&
+           response.pixelSize == packedPixelSize(format) &&
+           response.stride >= uint64_t(response.width) * response.pixelSize &&
+           response.height <= response.size / std::max<uint64_t>(1, response.stride) &&
+           response.size > 0;
+}
+
+} // namespace
+
+
+// SharedImage
+SharedImage::SharedImage(void* address, size_t size, const image_view::ImageView& view, const PixelFormat& format)
+    : m_address{address}
+    , m_size{size}
+    , m_view{view}
+    , m_format{format} {}
+
+SharedImage::~SharedImage() {
+    unmap();
+}
+
+SharedImage::SharedImage(SharedImage&& other) noexcept
+    : m_address{std::exchange(other.m_address, nullptr)}
+    , m_size{std::exchange(other.m_size, 0)}
+    , m_view{std::exchange(other.m_view, {})}
+    , m_format{other.m_format} {}
+
+SharedImage& SharedImage::operator=(SharedImage&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_address = std::exchange(other.m_address, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_view = std::exchange(other.m_view, {});
+        m_format = other.m_format;
+    }
+    return *this;
+}
+
+const image_view::ImageView& SharedImage::view() const noexcept {
+    return m_view;
+}
+
+const PixelFormat& SharedImage::format() const noexcept {
+    return m_format;
+}
+
+SharedImage::operator bool() const noexcept {
+    return m_address != nullptr;
+}
+
+void SharedImage::unmap() noexcept {
+    if (m_address != nullptr) {
+        ::munmap(m_address, m_size);
+        m_address = nullptr;
+    }
+}
+
+
+// DecodeClient
+DecodeClient::DecodeClient(const std::string& socketPath)
+    : m_mutex{}
+    , m_socket{-1}
+    {
+        sockaddr_un address{};
+        if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE("Invalid socket path: " + socketPath));
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+        m_socket = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (m_socket == -1) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot create socket")));
+        }
+        if (::connect(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            const std::string message = systemError("Cannot connect to " + socketPath);
+            ::close(m_socket);
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(message));
+        }
+    }
+
+DecodeClient::~DecodeClient() {
+    ::close(m_socket);
+}
+
+
+SharedImage DecodeClient::decode(const std::string& path, const PixelFormat& format) {
+    const Descriptor file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (file.get() == -1) {
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot open " + path)));
+    }
+    return decode(file.get(), format);
+}
+
+
+SharedImage DecodeClient::decode(const void* data, size_t size, const PixelFormat& format) {
+    const Descriptor file(::memfd_create("png_decoder_source", MFD_CLOEXEC));
+    if (file.get() == -1) {
+        throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot create memfd")));
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+    size_t offset = 0;
+    while (offset < size) {
+        const ssize_t written = ::write(file.get(), bytes + offset, size - offset);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written == -1) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot write memfd")));
+        }
+        offset += written;
+    }
+    return decode(file.get(), format);
+}
+
+
+SharedImage DecodeClient::decode(int fd, const PixelFormat& format) {
+    Response response{};
+    int received = -1;
+    {
+        std::lock_guard lock(m_mutex);
+        const Request request = makeRequest(format);
+        sendPacket(m_socket, &request, sizeof(request), fd);
+        if (receivePacket(m_socket, &response, sizeof(response), received) != sizeof(response)) {
+            if (received != -1) {
+                ::close(received);
+            }
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE("Connection to the daemon is closed"));
+        }
+    }
+    const Descriptor pixels(received);
+
+    // the message is null-terminated by the daemon, but not trusted to be
+    response.message[sizeof(response.message) - 1] = '\0';
+    switch (response.status) {
+    case Status::Ok:
+        break;
+    case Status::DecodingError:
+        throw exceptions::DecodingException(response.message);
+    default:
+        throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(std::string("Daemon error: ") + response.message));
+    }
+
+    if (!validResponse(response, format, pixels.get())) {
+        throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE("Invalid response of the daemon"));
+    }
+
+    // the memfd is sealed against writes, a private mapping still lets the caller modify its copy of the pages
+    void* address = ::mmap(nullptr, response.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, pixels.get(), 0);
+    if (address == MAP_FAILED) {
+        throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot map pixels")));
+    }
+
+    image_view::ImageView view(static_cast<unsigned char*>(address), response.width, response.height,
+                               response.stride, response.pixelSize);
+    return SharedImage(address, response.size, view, format);
+}
+
+
+} // namespace png_decoder::daemon
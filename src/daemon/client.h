@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include "image-view/image_view.h"
+#include "misc/pixel_format.h"
+
+
+namespace png_decoder::daemon {
+
+/*
+* Pixels decoded by `png_decoderd`, mapped from the sealed memfd of the response.
+* The mapping is private: writes through the view are allowed but are never seen by other processes.
+*/
+class SharedImage {
+public:
+    SharedImage() = default;
+    ~SharedImage();
+
+    SharedImage(SharedImage&& other) noexcept;
+    SharedImage& operator=(SharedImage&& other) noexcept;
+    SharedImage(const SharedImage&) = delete;
+    SharedImage& operator=(const SharedImage&) = delete;
+
+    // empty if the image is not mapped
+    const image_view::ImageView& view() const noexcept;
+    const PixelFormat& format() const noexcept;
+
+    explicit operator bool() const noexcept;
+
+private:
+    friend class DecodeClient;
+
+    SharedImage(void* address, size_t size, const image_view::ImageView& view, const PixelFormat& format);
+    void unmap() noexcept;
+
+private:
+    void* m_address = nullptr;
+    size_t m_size = 0;
+    image_view::ImageView m_view{};
+    PixelFormat m_format{};
+};
+
+
+/*
+* Connection to `png_decoderd`. Files are opened by the client and passed to the daemon as descriptors,
+* so relative paths and file permissions are those of the calling process.
+*
+* Decoding errors reported by the daemon are rethrown as `DecodingException`, failures of the connection
+* or of the daemon itself as `DaemonException`. Requests of one client are served one at a time:
+* threads wanting concurrent decodes should use a client each.
+*/
+class DecodeClient {
+public:
+    explicit DecodeClient(const std::string& socketPath);
+    ~DecodeClient();
+
+    DecodeClient(const DecodeClient&) = delete;
+    DecodeClient& operator=(const DecodeClient&) = delete;
+
+    SharedImage decode(const std::string& path, const PixelFormat& format = {});
+    /* the image is copied into a memfd once, the daemon reads it from there */
+    SharedImage decode(const void* data, size_t size, const PixelFormat& format = {});
+    /* `fd` is a readable descriptor of a regular file (or memfd) with the PNG image, it is not closed */
+    SharedImage decode(int fd, const PixelFormat& format = {});
+
+private:
+    std::mutex m_mutex;
+    int m_socket;
+};
+
+
+} // namespace png_decoder::daemon
@@ -0,0 +1,114 @@
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "protocol.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder::daemon {
+
+Request makeRequest(const PixelFormat& format) {
+    Request request{};
+    request.channelOrder = static_cast<uint8_t>(format.channelOrder);
+    request.alphaMode = static_cast<uint8_t>(format.alphaMode);
+    request.sampleType = static_cast<uint8_t>(format.sampleType);
+    request.transferFunction = static_cast<uint8_t>(format.transferFunction);
+    return request;
+}
+
+
+bool parseRequest(const Request& request, PixelFormat& format) {
+    if (request.version != PROTOCOL_VERSION ||
+        request.channelOrder > static_cast<uint8_t>(ChannelOrder::ARGB) ||
+        request.alphaMode > static_cast<uint8_t>(AlphaMode::Premultiplied) ||
+        request.sampleType > static_cast<uint8_t>(SampleType::Float32) ||
+        request.transferFunction > static_cast<uint8_t>(TransferFunction::Linear)) {
+        return false;
+    }
+
+    format.channelOrder = static_cast<ChannelOrder>(request.channelOrder);
+    format.alphaMode = static_cast<AlphaMode>(request.alphaMode);
+    format.sampleType = static_cast<SampleType>(request.sampleType);
+    format.transferFunction = static_cast<TransferFunction>(request.transferFunction);
+    return true;
+}
+
+
+void sendPacket(int socket, const void* data, size_t size, int fd) {
+    iovec vector{const_cast<void*>(data), size};
+
+    msghdr message{};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    if (fd != -1) {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    }
+
+    ssize_t sent = 0;
+    do {
+        // a closed peer is reported as EPIPE instead of killing the process with SIGPIPE
+        sent = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+
+    if (sent != static_cast<ssize_t>(size)) {
+        throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(
+            std::string("Cannot send packet: ") + (sent == -1 ? std::strerror(errno) : "partially sent")));
+    }
+}
+
+
+size_t receivePacket(int socket, void* data, size_t size, int& fd) {
+    fd = -1;
+    iovec vector{data, size};
+
+    msghdr message{};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received = 0;
+    do {
+        received = ::recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+    } while (received == -1 && errno == EINTR);
+
+    if (received == -1) {
+        throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(
+            std::string("Cannot receive packet: ") + std::strerror(errno)));
+    }
+
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS &&
+            header->cmsg_len == CMSG_LEN(sizeof(int))) {
+            std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+        }
+    }
+
+    // descriptors beyond the single expected one are closed by the kernel when MSG_CTRUNC is set
+    if ((message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+        if (fd != -1) {
+            ::close(fd);
+            fd = -1;
+        }
+        throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE("Received truncated packet"));
+    }
+
+    return received;
+}
+
+
+} // namespace png_decoder::daemon
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "misc/pixel_format.h"
+
+
+namespace png_decoder::daemon {
+
+/*
+* Wire protocol of `png_decoderd` over a SOCK_SEQPACKET Unix domain socket, in host byte order.
+*
+* Every request is a single `Request` packet carrying a readable descriptor of the PNG file (SCM_RIGHTS):
+* the daemon reads the file with the permissions of the client rather than its own.
+* Every response is a single `Response` packet; on success it carries a sealed memfd holding
+* `height` rows of `stride` bytes, which the client maps instead of receiving the pixels through the socket.
+*/
+
+constexpr uint32_t PROTOCOL_VERSION = 1;
+
+enum class Status : uint32_t {
+    Ok = 0,
+    // the image is malformed or unsupported
+    DecodingError,
+    // the image exceeds limits of the daemon
+    LimitExceeded,
+    // the request is malformed or of another protocol version
+    ProtocolError,
+    // the daemon failed to allocate or map the pixels
+    InternalError,
+};
+
+struct Request {
+    uint32_t version = PROTOCOL_VERSION;
+    uint8_t channelOrder = 0;
+    uint8_t alphaMode = 0;
+    uint8_t sampleType = 0;
+    uint8_t transferFunction = 0;
+};
+
+struct Response {
+    uint32_t version = PROTOCOL_VERSION;
+    Status status = Status::Ok;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t stride = 0;
+    uint64_t pixelSize = 0;
+    // size of the memfd, at least `stride * height`
+    uint64_t size = 0;
+    // null-terminated description of the error unless the status is `Ok`
+    char message[512] = {};
+};
+
+static_assert(std::is_trivially_copyable_v<Request>);
+static_assert(std::is_trivially_copyable_v<Response>);
+
+
+Request makeRequest(const PixelFormat& format);
+/* false if the request is of another version or its format has out of range values */
+bool parseRequest(const Request& request, PixelFormat& format);
+
+/* sends one packet with an optional descriptor (-1 for none), throws `DaemonException` on failure */
+void sendPacket(int socket, const void* data, size_t size, int fd);
+/*
+* receives one packet into `data`, returning the number of received bytes or 0 if the peer closed the connection.
+* `fd` is set to the attached descriptor or -1, the caller owns it. Truncated packets throw `DaemonException`.
+*/
+size_t receivePacket(int socket, void* data, size_t size, int& fd);
+
+
+} // namespace png_decoder::daemon
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "png_decoder.h"
+#include "exceptions/exceptions.h"
+#include "utils/memory_stream.h"
+
+
+namespace png_decoder::daemon {
+
+namespace {
+
+std::string systemError(const std::string& action) {
+    return action + ": " + std::strerror(errno);
+}
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address{};
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE("Invalid socket path: " + path));
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return address;
+}
+
+void setResponseError(Response& response, Status status, const std::string& message) {
+    response = Response{};
+    response.status = status;
+    std::strncpy(response.message, message.c_str(), sizeof(response.message) - 1);
+}
+
+} // namespace
+
+
+DecodeServer::DecodeServer(std::string socketPath, ServerOptions options)
+    : m_socketPath{std::move(socketPath)}
+    , m_options{std::move(options)}
+    , m_listener{-1}
+    , m_mutex{}
+    , m_finished{}
+    , m_connections{}
+    , m_activeConnections{0}
+    , m_stopped{false}
+    , m_workers(std::max<size_t>(1, m_options.threadsCount))
+    {
+        const size_t alignment = m_options.rowAlignment;
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(
+                "Row alignment must be a power of two: " + std::to_string(alignment)));
+        }
+
+        const sockaddr_un address = socketAddress(m_socketPath);
+        const sockaddr* generic = reinterpret_cast<const sockaddr*>(&address);
+
+        m_listener = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (m_listener == -1) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot create socket")));
+        }
+
+        // a socket file nobody listens on is left by a daemon which did not exit cleanly
+        if (::connect(m_listener, generic, sizeof(address)) == 0) {
+            ::close(m_listener);
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE("Socket is already served: " + m_socketPath));
+        }
+        if (errno == ECONNREFUSED) {
+            ::unlink(m_socketPath.c_str());
+        }
+        ::close(m_listener);
+
+        m_listener = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (m_listener == -1 || ::bind(m_listener, generic, sizeof(address)) != 0 || ::listen(m_listener, SOMAXCONN) != 0) {
+            const std::string message = systemError("Cannot listen on " + m_socketPath);
+            if (m_listener != -1) {
+                ::close(m_listener);
+            }
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(message));
+        }
+    }
+
+
+DecodeServer::~DecodeServer() {
+    stop();
+
+    {
+        std::unique_lock lock(m_mutex);
+        m_finished.wait(lock, [this]() { return m_activeConnections == 0; });
+    }
+
+    ::close(m_listener);
+    ::unlink(m_socketPath.c_str());
+}
+
+
+void DecodeServer::run() {
+    while (true) {
+        const int connection = ::accept4(m_listener, nullptr, nullptr, SOCK_CLOEXEC);
+
+        std::lock_guard lock(m_mutex);
+        if (m_stopped) {
+            if (connection != -1) {
+                ::close(connection);
+            }
+            return;
+        }
+
+        if (connection == -1) {
+            // the connection was reset before being accepted, or a signal interrupted waiting
+            if (errno == ECONNABORTED || errno == EINTR) {
+                continue;
+            }
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot accept connection")));
+        }
+
+        m_connections.insert(connection);
+        ++m_activeConnections;
+        std::thread([this, connection]() { serve(connection); }).detach();
+    }
+}
+
+
+void DecodeServer::stop() {
+    std::lock_guard lock(m_mutex);
+    if (m_stopped) {
+        return;
+    }
+    m_stopped = true;
+
+    // wakes `accept` in `run` and `recvmsg` of every connection, descriptors are closed by their owners
+    ::shutdown(m_listener, SHUT_RDWR);
+    for (const int connection : m_connections) {
+        ::shutdown(connection, SHUT_RDWR);
+    }
+}
+
+
+void DecodeServer::serve(int connection) {
+    try {
+        while (true) {
+            Request request{};
+            int source = -1;
+            const size_t received = receivePacket(connection, &request, sizeof(request), source);
+            if (received == 0) {
+                break;
+            }
+
+            int pixels = -1;
+            Response response{};
+            if (received != sizeof(request)) {
+                setResponseError(response, Status::ProtocolError, "Request of unexpected size");
+            }
+            else {
+                response = handle(request, source, pixels);
+            }
+
+            if (source != -1) {
+                ::close(source);
+            }
+
+            try {
+                sendPacket(connection, &response, sizeof(response), pixels);
+            }
+            catch (...) {
+                if (pixels != -1) {
+                    ::close(pixels);
+                }
+                throw;
+            }
+            if (pixels != -1) {
+                ::close(pixels);
+            }
+        }
+    }
+    catch (const exceptions::DaemonException&) {
+        // the client is gone or broke the protocol, other connections are not affected
+    }
+
+    std::lock_guard lock(m_mutex);
+    m_connections.erase(connection);
+    ::close(connection);
+    --m_activeConnections;
+    m_finished.notify_all();
+}
+
+
+Response DecodeServer::handle(const Request& request, int source, int& pixels) {
+    Response response{};
+
+    PixelFormat format{};
+    if (!parseRequest(request, format)) {
+        setResponseError(response, Status::ProtocolError, "Unsupported request version or pixel format");
+        return response;
+    }
+    if (source == -1) {
+        setResponseError(response, Status::ProtocolError, "Request does not carry a file descriptor");
+        return response;
+    }
+
+    std::promise<void> done;
+    m_workers.submit([&]() {
+        decode(source, format, response, pixels);
+        done.set_value();
+    });
+    done.get_future().wait();
+
+    return response;
+}
+
+
+void DecodeServer::decode(int source, const PixelFormat& format, Response& response, int& pixels) const {
+    int fd = -1;
+    void* address = MAP_FAILED;
+    size_t size = 0;
+
+    try {
+        struct stat info{};
+        if (::fstat(source, &info) != 0 || !S_ISREG(info.st_mode)) {
+            setResponseError(response, Status::ProtocolError, "File descriptor does not refer to a regular file");
+            return;
+        }
+        if (static_cast<uint64_t>(info.st_size) > m_options.maxImageBytes) {
+            setResponseError(response, Status::LimitExceeded,
+                             "File of " + std::to_string(info.st_size) + " bytes exceeds the limit");
+            return;
+        }
+
+        // read rather than mapped: a client truncating its file while it is decoded must not crash the daemon
+        const std::vector<char> bytes = readSource(source, info.st_size);
+        utils::MemoryInputStream stream(bytes.data(), bytes.size());
+
+        DecodeOptions options{};
+        options.pixelFormat = format;
+        // oversized images are refused right after IHDR, before their data is read
+        options.limits.maxPixels = m_options.maxImageBytes / packedPixelSize(format);
+        PNGDecoder decoder(stream, options);
+
+        const IHDR& ihdr = decoder.getIHDR();
+        const size_t pixelSize = packedPixelSize(format);
+        const size_t stride = image_view::ImageBuffer::alignedStride(ihdr.width, pixelSize, m_options.rowAlignment);
+        if (ihdr.height > m_options.maxImageBytes / stride) {
+            setResponseError(response, Status::LimitExceeded,
+                             std::to_string(ihdr.width) + "x" + std::to_string(ihdr.height) + " image exceeds the limit");
+            return;
+        }
+        size = stride * ihdr.height;
+
+        fd = ::memfd_create("png_decoderd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd == -1) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot create memfd")));
+        }
+        // reserves the memory up front: running out of it is reported here rather than by SIGBUS while decoding
+        if (const int error = ::posix_fallocate(fd, 0, size); error != 0) {
+            errno = error;
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot allocate pixels")));
+        }
+
+        address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot map pixels")));
+        }
+        decoder.decode(image_view::ImageView(static_cast<unsigned char*>(address), ihdr.width, ihdr.height, stride, pixelSize));
+        ::munmap(address, size);
+        address = MAP_FAILED;
+
+        // sealing requires no writable shared mapping to remain, clients get pixels nobody can change anymore
+        if (::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot seal pixels")));
+        }
+
+        response = Response{};
+        response.width = ihdr.width;
+        response.height = ihdr.height;
+        response.stride = stride;
+        response.pixelSize = pixelSize;
+        response.size = size;
+        pixels = std::exchange(fd, -1);
+        return;
+    }
+    catch (const exceptions::DaemonException& e) {
+        setResponseError(response, Status::InternalError, e.what());
+    }
+    catch (const exceptions::LimitExceededException& e) {
+        setResponseError(response, Status::LimitExceeded, e.what());
+    }
+    catch (const exceptions::DecodingException& e) {
+        setResponseError(response, Status::DecodingError, e.what());
+    }
+    catch (const std::exception& e) {
+        setResponseError(response, Status::InternalError, e.what());
+    }
+
+    if (address != MAP_FAILED) {
+        ::munmap(address, size);
+    }
+    if (fd != -1) {
+        ::close(fd);
+    }
+}
+
+
+std::vector<char> DecodeServer::readSource(int source, size_t size) {
+    std::vector<char> bytes(size);
+    size_t offset = 0;
+    while (offset < size) {
+        const ssize_t read = ::pread(source, bytes.data() + offset, size - offset, offset);
+        if (read == -1 && errno == EINTR) {
+            continue;
+        }
+        if (read == -1) {
+            throw exceptions::DaemonException(PNG_DECODER_ERROR_MESSAGE(systemError("Cannot read file")));
+        }
+        if (read == 0) {
+            break;
+        }
+        offset += read;
+    }
+    // a truncated file is decoded as such and reported as a decoding error
+    bytes.resize(offset);
+    return bytes;
+}
+
+
+} // namespace png_decoder::daemon
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "daemon/protocol.h"
+#include "image-view/image_view.h"
+#include "thread-pool/thread_pool.h"
+
+
+namespace png_decoder::daemon {
+
+struct ServerOptions {
+    // decoding threads shared by all clients, connections themselves only wait for the socket
+    size_t threadsCount = std::thread::hardware_concurrency();
+    // images whose pixels would take more bytes are refused with `Status::LimitExceeded`
+    uint64_t maxImageBytes = uint64_t(1) << 30;
+    // every row of the delivered pixels starts at this boundary (a power of two)
+    size_t rowAlignment = image_view::ImageBuffer::DEFAULT_ALIGNMENT;
+};
+
+
+/*
+* Decode service of `png_decoderd`, listening on a Unix domain socket (see `protocol.h`).
+*
+* Every connection is served by its own thread which only receives requests and sends responses;
+* decoding runs on a single pool of `threadsCount` workers, so the daemon never uses more cores than that
+* however many clients are connected. Pixels are decoded straight into a memfd which is sealed against
+* modification and passed to the client, so they are never copied after decoding.
+*/
+class DecodeServer {
+public:
+    DecodeServer(std::string socketPath, ServerOptions options = {});
+    ~DecodeServer();
+
+    DecodeServer(const DecodeServer&) = delete;
+    DecodeServer& operator=(const DecodeServer&) = delete;
+
+    /* accepts connections until `stop` is called */
+    void run();
+    /* may be called from any thread: stops accepting and closes every connection, in-flight decodes are finished */
+    void stop();
+
+private:
+    void serve(int connection);
+    Response handle(const Request& request, int source, int& pixels);
+    void decode(int source, const PixelFormat& format, Response& response, int& pixels) const;
+    static std::vector<char> readSource(int source, size_t size);
+
+private:
+    const std::string m_socketPath;
+    const ServerOptions m_options;
+    int m_listener;
+
+    std::mutex m_mutex;
+    std::condition_variable m_finished;
+    std::set<int> m_connections;
+    // connection threads are detached, the destructor waits for this to drop to zero
+    size_t m_activeConnections;
+    bool m_stopped;
+
+    thread_pool::ThreadPool m_workers;
+};
+
+
+} // namespace png_decoder::daemon
@@ -1,5 +1,6 @@
+#include <algorithm>
 #include <cstdint>
-#include <iostream>
+#include <cstdlib>
 
 #include "misc/structs.h"
 #include "defilter.h"
@@ -8,28 +9,30 @@
 namespace png_decoder::defilter {
 
 
-uint32_t Defilter::mod(uint32_t value) {
-    return (value % MOD + MOD) % MOD;
-}
-
-uint32_t Defilter::prev(const Scanline& scanline, uint32_t pos, uint32_t bpp) {
-    return pos < bpp ? 0 : scanline.data[pos - bpp];
+bool Defilter::dependsOnPreviousScanline(uint8_t filterMethod) noexcept {
+    return filterMethod != static_cast<uint8_t>(FilterTypes::None) &&
+           filterMethod != static_cast<uint8_t>(FilterTypes::Sub);
 }
 
 
 // defilters
 
+/*
+* Defilters work on raw row pointers with 8-bit wrapping arithmetic: the first `bpp` bytes, which have
+* no left neighbour, are handled separately, so the main loops have no branches.
+*/
+
 // Sub
 bool Sub::applicable(const Scanline& scanline) const {
     return scanline.filterMethod == static_cast<uint8_t>(FilterTypes::Sub);
 }
 
 void Sub::apply(Scanline& scanline, [[maybe_unused]] const Scanline& previousDefilteredScanline, uint32_t bpp) const {
-    for (size_t i = 0; i < scanline.data.size(); ++i) {
-        uint32_t previous = prev(scanline, i, bpp);
-        uint32_t current = scanline.data[i];
+    unsigned char* current = scanline.data.data();
+    const size_t size = scanline.data.size();
 
-        scanline.data[i] = mod(current + previous);
+    for (size_t i = bpp; i < size; ++i) {
+        current[i] = static_cast<uint8_t>(current[i] + current[i - bpp]);
     }
 }
 
@@ -40,11 +43,12 @@ bool Up::applicable(const Scanline& scanline) const {
 }
 
 void Up::apply(Scanline& scanline, const Scanline& previousDefilteredScanline, [[maybe_unused]] uint32_t bpp) const {
-    for (size_t i = 0; i < scanline.data.size(); ++i) {
-        uint32_t prior = previousDefilteredScanline.data[i];
-        uint32_t current = scanline.data[i];
+    unsigned char* current = scanline.data.data();
+    const unsigned char* prior = previousDefilteredScanline.data.data();
+    const size_t size = scanline.data.size();
 
-        scanline.data[i] = mod(current + prior);
+    for (size_t i = 0; i < size; ++i) {
+        current[i] = static_cast<uint8_t>(current[i] + prior[i]);
     }
 }
 
@@ -55,12 +59,16 @@ bool Average::applicable(const Scanline& scanline) const {
 }
 
 void Average::apply(Scanline& scanline, const Scanline& previousDefilteredScanline, uint32_t bpp) const {
-    for (size_t i = 0; i < scanline.data.size(); ++i) {
-        uint32_t previous = prev(scanline, i, bpp);
-        uint32_t prior = previousDefilteredScanline.data[i];
-        uint32_t current = scanline.data[i];
+    unsigned char* current = scanline.data.data();
+    const unsigned char* prior = previousDefilteredScanline.data.data();
+    const size_t size = scanline.data.size();
+    const size_t head = std::min<size_t>(bpp, size);
 
-        scanline.data[i] = mod(current + (previous + prior) / 2);
+    for (size_t i = 0; i < head; ++i) {
+        current[i] = static_cast<uint8_t>(current[i] + prior[i] / 2);
+    }
+    for (size_t i = head; i < size; ++i) {
+        current[i] = static_cast<uint8_t>(current[i] + (uint32_t(current[i - bpp]) + prior[i]) / 2);
     }
 }
 
@@ -71,13 +79,17 @@ bool Paeth::applicable(const Scanline& scanline) const {
 }
 
 void Paeth::apply(Scanline& scanline, const Scanline& previousDefilteredScanline, uint32_t bpp) const {
-    for (size_t i = 0; i < scanline.data.size(); ++i) {
-        uint32_t previous = prev(scanline, i, bpp);
-        uint32_t prior = previousDefilteredScanline.data[i];
-        uint32_t priorLeft = prev(previousDefilteredScanline, i, bpp);
-        uint32_t current = scanline.data[i];
-
-        scanline.data[i] = current + mod(predictor(previous, prior, priorLeft));
+    unsigned char* current = scanline.data.data();
+    const unsigned char* prior = previousDefilteredScanline.data.data();
+    const size_t size = scanline.data.size();
+    const size_t head = std::min<size_t>(bpp, size);
+
+    // without left neighbours the predictor is always the byte above
+    for (size_t i = 0; i < head; ++i) {
+        current[i] = static_cast<uint8_t>(current[i] + prior[i]);
+    }
+    for (size_t i = head; i < size; ++i) {
+        current[i] = static_cast<uint8_t>(current[i] + predictor(current[i - bpp], prior[i], prior[i - bpp]));
     }
 }
 
@@ -15,6 +15,9 @@ public:
     virtual void apply(Scanline& scanline, const Scanline& previousDefilteredScanline, uint32_t bpp) const = 0;
     virtual ~Defilter() = default;
 
+    /* whether defiltering a scanline with the filter method requires the previous scanline */
+    static bool dependsOnPreviousScanline(uint8_t filterMethod) noexcept;
+
 protected:
     enum class FilterTypes : uint8_t {
         None = 0,
@@ -23,12 +26,6 @@ protected:
         Average,
         Paeth,
     };
-
-    static uint32_t mod(uint32_t value);
-    static uint32_t prev(const Scanline& scanline, uint32_t pos, uint32_t bpp);
-
-private:
-    static constexpr uint32_t MOD = 256;
 };
 
 
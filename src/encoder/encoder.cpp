@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <string>
+#include <zlib.h>
+
+#include "encoder.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder::encoder {
+
+namespace {
+
+enum class FilterTypes : uint8_t {
+    None = 0,
+    Sub,
+    Up,
+    Average,
+    Paeth,
+};
+
+constexpr size_t FILTERS_COUNT = 5;
+
+uint8_t paethPredictor(int32_t a, int32_t b, int32_t c) {
+    int32_t p = a + b - c;
+    int32_t pa = std::abs(p - a);
+    int32_t pb = std::abs(p - b);
+    int32_t pc = std::abs(p - c);
+
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+} // namespace
+
+
+PNGEncoder::PNGEncoder(EncodeOptions options) : m_options{std::move(options)} {}
+
+
+void PNGEncoder::encode(const Image& image, std::ostream& stream) const {
+    static constexpr unsigned char SIGNATURE[] = {137, 80, 78, 71, 13, 10, 26, 10};
+    static constexpr uint8_t BIT_DEPTH = 8;
+    static constexpr uint8_t RGB_ALPHA_COLOR_TYPE = 6;
+
+    stream.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+
+    std::vector<unsigned char> ihdr;
+    appendBigEndian(ihdr, image.Width());
+    appendBigEndian(ihdr, image.Height());
+    // bit depth, color type, compression, filter and interlace methods
+    ihdr.insert(ihdr.end(), {BIT_DEPTH, RGB_ALPHA_COLOR_TYPE, 0, 0, 0});
+    writeChunk(stream, IHDR_CHUNK_TYPE, ihdr);
+
+    std::vector<uint32_t> segmentRows;
+    std::vector<uint32_t> segmentOffsets;
+    std::vector<unsigned char> data = compress(image, segmentRows, segmentOffsets);
+
+    if (segmentRows.size() > 1) {
+        std::vector<unsigned char> zseg;
+        appendBigEndian(zseg, segmentRows.size());
+        for (size_t i = 0; i < segmentRows.size(); ++i) {
+            appendBigEndian(zseg, segmentRows[i]);
+            appendBigEndian(zseg, segmentOffsets[i]);
+        }
+        writeChunk(stream, ZSEG_CHUNK_TYPE, zseg);
+    }
+
+    for (size_t offset = 0; offset < data.size(); offset += MAX_IDAT_LENGTH) {
+        const size_t length = std::min(MAX_IDAT_LENGTH, data.size() - offset);
+        writeChunk(stream, IDAT_CHUNK_TYPE, std::vector<unsigned char>(data.begin() + offset, data.begin() + offset + length));
+    }
+
+    writeChunk(stream, IEND_CHUNK_TYPE, {});
+
+    if (!stream) {
+        throw exceptions::EncodingException(PNG_DECODER_ERROR_MESSAGE("Cannot write to output stream"));
+    }
+}
+
+
+std::vector<unsigned char> PNGEncoder::compress(const Image& image, std::vector<uint32_t>& segmentRows,
+                                                std::vector<uint32_t>& segmentOffsets) const {
+    const uint32_t height = image.Height();
+    const uint32_t width = image.Width();
+    const uint32_t segmentsCount = std::clamp<uint32_t>(m_options.segmentsCount, 1, std::max<uint32_t>(1, height));
+
+    for (uint32_t i = 0; i < segmentsCount; ++i) {
+        segmentRows.push_back(static_cast<uint64_t>(height) * i / segmentsCount);
+    }
+
+    z_stream strm{};
+    if (deflateInit(&strm, m_options.compressionLevel) != Z_OK) {
+        throw exceptions::EncodingException(PNG_DECODER_ERROR_MESSAGE("zlib: cannot initialize deflate"));
+    }
+
+    std::vector<unsigned char> result;
+    std::array<unsigned char, 16384> out{};
+
+    auto deflateBytes = [&](const unsigned char* bytes, size_t size, int flush) {
+        strm.next_in = const_cast<unsigned char*>(bytes);
+        strm.avail_in = size;
+        do {
+            strm.next_out = out.data();
+            strm.avail_out = out.size();
+            if (::deflate(&strm, flush) == Z_STREAM_ERROR) {
+                deflateEnd(&strm);
+                throw exceptions::EncodingException(PNG_DECODER_ERROR_MESSAGE("zlib: deflate failed"));
+            }
+            result.insert(result.end(), out.data(), out.data() + out.size() - strm.avail_out);
+        } while (strm.avail_out == 0);
+    };
+
+    std::vector<unsigned char> previous(BYTES_PER_PIXEL * width, 0);
+    std::vector<unsigned char> scanline(BYTES_PER_PIXEL * width, 0);
+    std::vector<unsigned char> filtered;
+
+    size_t segment = 0;
+    for (uint32_t row = 0; row < height; ++row) {
+        const bool segmentStart = (segment < segmentRows.size() && segmentRows[segment] == row);
+        if (segmentStart) {
+            // full flush resets the deflate window, so the next segment does not refer to the previous one
+            if (segment > 0) {
+                deflateBytes(nullptr, 0, Z_FULL_FLUSH);
+            }
+            segmentOffsets.push_back(result.size());
+            ++segment;
+        }
+
+        for (uint32_t col = 0; col < width; ++col) {
+            const RGB& pixel = image(row, col);
+            scanline[BYTES_PER_PIXEL * col] = pixel.r;
+            scanline[BYTES_PER_PIXEL * col + 1] = pixel.g;
+            scanline[BYTES_PER_PIXEL * col + 2] = pixel.b;
+            scanline[BYTES_PER_PIXEL * col + 3] = pixel.a;
+        }
+
+        filterScanline(scanline, previous, segmentStart, filtered);
+        deflateBytes(filtered.data(), filtered.size(), Z_NO_FLUSH);
+        std::swap(previous, scanline);
+    }
+
+    deflateBytes(nullptr, 0, Z_FINISH);
+    deflateEnd(&strm);
+
+    return result;
+}
+
+
+void PNGEncoder::filterScanline(const std::vector<unsigned char>& scanline, const std::vector<unsigned char>& previous,
+                                bool segmentStart, std::vector<unsigned char>& filtered) {
+    const size_t size = scanline.size();
+    const size_t candidatesCount = segmentStart ? static_cast<size_t>(FilterTypes::Up) : FILTERS_COUNT;
+
+    std::array<std::vector<unsigned char>, FILTERS_COUNT> candidates;
+    size_t best = 0;
+    uint64_t bestScore = UINT64_MAX;
+
+    for (size_t filter = 0; filter < candidatesCount; ++filter) {
+        std::vector<unsigned char>& candidate = candidates[filter];
+        candidate.resize(1 + size);
+        candidate[0] = filter;
+
+        uint64_t score = 0;
+        for (size_t i = 0; i < size; ++i) {
+            const int32_t a = i >= BYTES_PER_PIXEL ? scanline[i - BYTES_PER_PIXEL] : 0;
+            const int32_t b = previous[i];
+            const int32_t c = i >= BYTES_PER_PIXEL ? previous[i - BYTES_PER_PIXEL] : 0;
+
+            uint8_t predictor = 0;
+            switch (static_cast<FilterTypes>(filter)) {
+            case FilterTypes::None: predictor = 0; break;
+            case FilterTypes::Sub: predictor = a; break;
+            case FilterTypes::Up: predictor = b; break;
+            case FilterTypes::Average: predictor = (a + b) / 2; break;
+            case FilterTypes::Paeth: predictor = paethPredictor(a, b, c); break;
+            }
+
+            const uint8_t value = scanline[i] - predictor;
+            candidate[1 + i] = value;
+            score += std::abs(static_cast<int8_t>(value));
+        }
+
+        if (score < bestScore) {
+            bestScore = score;
+            best = filter;
+        }
+    }
+
+    filtered = std::move(candidates[best]);
+}
+
+
+void PNGEncoder::writeChunk(std::ostream& stream, uint32_t type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> header;
+    appendBigEndian(header, data.size());
+    appendBigEndian(header, type);
+
+    // crc covers chunk type and data
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, header.data() + sizeof(uint32_t), sizeof(uint32_t));
+    if (!data.empty()) {
+        // null buffer would reset the crc to its initial value
+        crc = crc32(crc, data.data(), data.size());
+    }
+
+    std::vector<unsigned char> trailer;
+    appendBigEndian(trailer, crc);
+
+    stream.write(reinterpret_cast<const char*>(header.data()), header.size());
+    stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+    stream.write(reinterpret_cast<const char*>(trailer.data()), trailer.size());
+}
+
+
+void PNGEncoder::appendBigEndian(std::vector<unsigned char>& bytes, uint32_t value) {
+    bytes.push_back((value >> 24) & 0xFF);
+    bytes.push_back((value >> 16) & 0xFF);
+    bytes.push_back((value >> 8) & 0xFF);
+    bytes.push_back(value & 0xFF);
+}
+
+
+} // namespace png_decoder::encoder
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "image.h"
+
+
+namespace png_decoder::encoder {
+
+struct EncodeOptions {
+    // zlib compression level, from 0 (none) to 9 (best)
+    int compressionLevel = 6;
+    /*
+    * Splits image data into segments of (almost) equal height which can be inflated and defiltered in parallel:
+    * the deflate stream is fully flushed at every segment boundary, the first scanline of each segment uses
+    * a filter not referring to the previous scanline, and a zsEG chunk records where the segments start.
+    * The result is still a regular PNG for any other decoder.
+    */
+    uint32_t segmentsCount = 1;
+};
+
+
+/*
+* Minimal encoder writing 8-bit RGBA non-interlaced images.
+* Filter of every scanline is chosen by the minimum sum of absolute differences heuristic.
+*/
+class PNGEncoder {
+public:
+    explicit PNGEncoder(EncodeOptions options = {});
+
+    void encode(const Image& image, std::ostream& stream) const;
+
+private:
+    std::vector<unsigned char> compress(const Image& image, std::vector<uint32_t>& segmentRows,
+                                        std::vector<uint32_t>& segmentOffsets) const;
+
+    static void filterScanline(const std::vector<unsigned char>& scanline, const std::vector<unsigned char>& previous,
+                               bool segmentStart, std::vector<unsigned char>& filtered);
+    static void writeChunk(std::ostream& stream, uint32_t type, const std::vector<unsigned char>& data);
+    static void appendBigEndian(std::vector<unsigned char>& bytes, uint32_t value);
+
+private:
+    static constexpr uint32_t BYTES_PER_PIXEL = 4;
+
+    static constexpr uint32_t IHDR_CHUNK_TYPE = 0x49484452UL;
+    static constexpr uint32_t IDAT_CHUNK_TYPE = 0x49444154UL;
+    static constexpr uint32_t IEND_CHUNK_TYPE = 0x49454e44UL;
+    static constexpr uint32_t ZSEG_CHUNK_TYPE = 0x7a734547UL;
+
+    static constexpr size_t MAX_IDAT_LENGTH = 1 << 20;
+
+private:
+    EncodeOptions m_options;
+};
+
+
+} // namespace png_decoder::encoder
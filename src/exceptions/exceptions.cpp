@@ -15,8 +15,12 @@ InvalidSignatureException::InvalidSignatureException() : DecodingException("Inva
 
 InvalidIHDRChunkException::InvalidIHDRChunkException() : DecodingException("Invalid IHDR chunk") {}
 
+InvalidIHDRChunkException::InvalidIHDRChunkException(const std::string& message) : DecodingException(message) {}
+
 InvalidPLTEChunkException::InvalidPLTEChunkException() : DecodingException("Invalid PLTE chunk") {}
 
+InvalidPLTEChunkException::InvalidPLTEChunkException(const std::string& message) : DecodingException(message) {}
+
 InvalidIENDChunkException::InvalidIENDChunkException() : DecodingException("Invalid IEND chunk") {}
 
 InvalidCRCException::InvalidCRCException(const std::string& message) : DecodingException(message) {}
@@ -27,10 +31,66 @@ CriticalChunkTypeChunkException::CriticalChunkTypeChunkException(const std::stri
 
 InvalidStreamException::InvalidStreamException(const std::string& message) : DecodingException(message) {}
 
+LimitExceededException::LimitExceededException(const std::string& message) : DecodingException(message) {}
+
+SinkException::SinkException(const std::string& message) : DecodingException(message) {}
+
+CacheException::CacheException(const std::string& message) : DecodingException(message) {}
+
+DaemonException::DaemonException(const std::string& message) : DecodingException(message) {}
+
+EncodingException::EncodingException(const std::string& message) : std::runtime_error(message) {}
+
 // zlib exceptions
 ZlibInvalidCompressionLevelException::ZlibInvalidCompressionLevelException() : DecodingException("zlib: invalid compression level") {}
 ZlibInvalidDeflateDataException::ZlibInvalidDeflateDataException() : DecodingException("zlib: invalid or incomplete deflate data") {}
 ZlibOutOfMemoryException::ZlibOutOfMemoryException() : DecodingException("zlib: out of memory") {}
 ZlibVersionMismatchException::ZlibVersionMismatchException() : DecodingException("zlib: zlib version mismatch") {}
 
+
+void throwDecodeError(const DecodeError& error) {
+    switch (error.code) {
+    case DecodeErrorCode::InvalidSignature:
+        throw InvalidSignatureException();
+    case DecodeErrorCode::MissingIHDR:
+        throw InvalidIHDRChunkException();
+    case DecodeErrorCode::InvalidIHDRLength:
+    case DecodeErrorCode::InvalidImageSize:
+    case DecodeErrorCode::UnsupportedBitDepth:
+    case DecodeErrorCode::UnsupportedCompressionMethod:
+    case DecodeErrorCode::InvalidInterlaceMethod:
+    case DecodeErrorCode::ImageTooWide:
+        throw InvalidIHDRChunkException(PNG_DECODER_ERROR_MESSAGE(error.message()));
+    case DecodeErrorCode::UnsupportedColorType:
+        throw InvalidColorTypeChunkException(PNG_DECODER_ERROR_MESSAGE(error.message()));
+    case DecodeErrorCode::InvalidPLTELength:
+    case DecodeErrorCode::MultiplePLTE:
+    case DecodeErrorCode::MissingPLTE:
+        throw InvalidPLTEChunkException(PNG_DECODER_ERROR_MESSAGE(error.message()));
+    case DecodeErrorCode::InvalidIEND:
+        throw InvalidIENDChunkException();
+    case DecodeErrorCode::InvalidCRC:
+        throw InvalidCRCException(PNG_DECODER_ERROR_MESSAGE(error.message()));
+    case DecodeErrorCode::InvalidChunkLength:
+    case DecodeErrorCode::TruncatedStream:
+        throw InvalidStreamException(PNG_DECODER_ERROR_MESSAGE(error.message()));
+    case DecodeErrorCode::InvalidDeflateData:
+        throw ZlibInvalidDeflateDataException();
+    case DecodeErrorCode::ZlibOutOfMemory:
+        throw ZlibOutOfMemoryException();
+    case DecodeErrorCode::ZlibStreamError:
+        throw ZlibInvalidCompressionLevelException();
+    case DecodeErrorCode::ZlibVersionMismatch:
+        throw ZlibVersionMismatchException();
+    case DecodeErrorCode::TooManyPixels:
+    case DecodeErrorCode::TooManyInflatedBytes:
+    case DecodeErrorCode::TooManyChunks:
+    case DecodeErrorCode::ChunkTooLong:
+    case DecodeErrorCode::TooMuchMemory:
+        throw LimitExceededException(PNG_DECODER_ERROR_MESSAGE(error.message()));
+    default:
+        throw DecodingException(PNG_DECODER_ERROR_MESSAGE(error.message()));
+    }
+}
+
 } // namespace png_decoder::exceptions
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <stdexcept>
+#include <string>
+
+#include "misc/decode_error.h"
 
 #define PNG_DECODER_ERROR_MESSAGE(str) (png_decoder::exceptions::getErrorMessage(__FILE__, __LINE__, str))
 
@@ -23,11 +26,13 @@ public:
 class InvalidIHDRChunkException : public DecodingException {
 public:
     InvalidIHDRChunkException();
+    InvalidIHDRChunkException(const std::string& message);
 };
 
 class InvalidPLTEChunkException : public DecodingException {
 public:
     InvalidPLTEChunkException();
+    InvalidPLTEChunkException(const std::string& message);
 };
 
 class InvalidIENDChunkException : public DecodingException {
@@ -55,6 +60,33 @@ public:
     InvalidStreamException(const std::string& message);
 };
 
+// one of `DecodeLimits` is exceeded, the image itself may be valid
+class LimitExceededException : public DecodingException {
+public:
+    LimitExceededException(const std::string& message);
+};
+
+class SinkException : public DecodingException {
+public:
+    SinkException(const std::string& message);
+};
+
+class CacheException : public DecodingException {
+public:
+    CacheException(const std::string& message);
+};
+
+class DaemonException : public DecodingException {
+public:
+    DaemonException(const std::string& message);
+};
+
+
+class EncodingException : public std::runtime_error {
+public:
+    EncodingException(const std::string& message);
+};
+
 
 // zlib wrapping exceptions
 class ZlibInvalidCompressionLevelException : public DecodingException {
@@ -80,4 +112,8 @@ public:
     ZlibVersionMismatchException();
 };
 
+
+/* throws the exception of the throwing API corresponding to the error code */
+[[noreturn]] void throwDecodeError(const DecodeError& error);
+
 } // namespace png_decoder::exceptions
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <string>
+
+#include "image_view.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder::image_view {
+
+// ImageView
+ImageView::ImageView(unsigned char* data, uint32_t width, uint32_t height, size_t stride, size_t pixelSize)
+    : m_data{data}
+    , m_width{width}
+    , m_height{height}
+    , m_stride{stride}
+    , m_pixelSize{pixelSize}
+    {
+        if (static_cast<size_t>(width) * pixelSize > stride) {
+            throw exceptions::DecodingException(PNG_DECODER_ERROR_MESSAGE(
+                "Stride " + std::to_string(stride) + " is less than the row of " + std::to_string(width) + " pixels"));
+        }
+    }
+
+unsigned char* ImageView::data() const noexcept {
+    return m_data;
+}
+
+uint32_t ImageView::width() const noexcept {
+    return m_width;
+}
+
+uint32_t ImageView::height() const noexcept {
+    return m_height;
+}
+
+size_t ImageView::stride() const noexcept {
+    return m_stride;
+}
+
+size_t ImageView::pixelSize() const noexcept {
+    return m_pixelSize;
+}
+
+size_t ImageView::size() const noexcept {
+    if (m_height == 0) {
+        return 0;
+    }
+    return (m_height - 1) * m_stride + m_width * m_pixelSize;
+}
+
+unsigned char* ImageView::row(uint32_t y) const noexcept {
+    return m_data + y * m_stride;
+}
+
+unsigned char* ImageView::at(uint32_t y, uint32_t x) const noexcept {
+    return row(y) + x * m_pixelSize;
+}
+
+ImageView ImageView::crop(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const {
+    if (static_cast<uint64_t>(x) + width > m_width || static_cast<uint64_t>(y) + height > m_height) {
+        throw exceptions::DecodingException(PNG_DECODER_ERROR_MESSAGE(
+            "Crop " + std::to_string(width) + "x" + std::to_string(height) + "+" + std::to_string(x) + "+" +
+            std::to_string(y) + " is out of " + std::to_string(m_width) + "x" + std::to_string(m_height) + " view"));
+    }
+    return ImageView(at(y, x), width, height, m_stride, m_pixelSize);
+}
+
+bool ImageView::rowsAligned(size_t alignment) const noexcept {
+    return reinterpret_cast<uintptr_t>(m_data) % alignment == 0 && m_stride % alignment == 0;
+}
+
+
+// ImageBuffer
+ImageBuffer::ImageBuffer(uint32_t width, uint32_t height, const PixelFormat& format, size_t alignment)
+    : m_data{nullptr, AlignedDeleter{alignment}}
+    , m_view{}
+    {
+        // required by aligned operator new
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+            throw exceptions::DecodingException(PNG_DECODER_ERROR_MESSAGE(
+                "Alignment must be a power of two: " + std::to_string(alignment)));
+        }
+
+        const size_t pixelSize = packedPixelSize(format);
+        const size_t stride = alignedStride(width, pixelSize, alignment);
+        // at least one byte, so that the view of an empty image still points to owned memory
+        const size_t size = std::max<size_t>(1, stride * height);
+
+        m_data.reset(static_cast<unsigned char*>(::operator new[](size, std::align_val_t(alignment))));
+        m_view = ImageView(m_data.get(), width, height, stride, pixelSize);
+    }
+
+const ImageView& ImageBuffer::view() const noexcept {
+    return m_view;
+}
+
+size_t ImageBuffer::alignedStride(uint32_t width, size_t pixelSize, size_t alignment) {
+    const size_t rowSize = width * pixelSize;
+    return (rowSize + alignment - 1) / alignment * alignment;
+}
+
+void ImageBuffer::AlignedDeleter::operator()(unsigned char* data) const {
+    ::operator delete[](data, std::align_val_t(alignment));
+}
+
+} // namespace png_decoder::image_view
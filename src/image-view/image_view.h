@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "misc/pixel_format.h"
+
+
+namespace png_decoder::image_view {
+
+/*
+* Non-owning view of packed pixels with an explicit distance between row starts (`stride`, in bytes).
+* Can wrap memory owned by the caller (shared memory, mapped textures) and be decoded into with `sink::BufferSink`.
+* Copies of a view and its crops refer to the same memory.
+*/
+class ImageView {
+public:
+    ImageView() = default;
+    ImageView(unsigned char* data, uint32_t width, uint32_t height, size_t stride, size_t pixelSize = PACKED_PIXEL_SIZE);
+
+    unsigned char* data() const noexcept;
+    uint32_t width() const noexcept;
+    uint32_t height() const noexcept;
+    size_t stride() const noexcept;
+    size_t pixelSize() const noexcept;
+    // bytes from the first pixel to the end of the last one
+    size_t size() const noexcept;
+
+    unsigned char* row(uint32_t y) const noexcept;
+    unsigned char* at(uint32_t y, uint32_t x) const noexcept;
+
+    /* zero-copy sub-view of `width` x `height` pixels starting at column `x` and row `y` */
+    ImageView crop(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+    bool rowsAligned(size_t alignment) const noexcept;
+
+private:
+    unsigned char* m_data = nullptr;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    size_t m_stride = 0;
+    size_t m_pixelSize = PACKED_PIXEL_SIZE;
+};
+
+
+/*
+* Owning storage of packed pixels whose every row starts at an `alignment`-byte boundary
+* (64 by default: a cache line, and enough for any SIMD load of a row start).
+*/
+class ImageBuffer {
+public:
+    ImageBuffer(uint32_t width, uint32_t height, const PixelFormat& format = {}, size_t alignment = DEFAULT_ALIGNMENT);
+
+    const ImageView& view() const noexcept;
+
+    static size_t alignedStride(uint32_t width, size_t pixelSize, size_t alignment);
+
+public:
+    static constexpr size_t DEFAULT_ALIGNMENT = 64;
+
+private:
+    struct AlignedDeleter {
+        size_t alignment;
+        void operator()(unsigned char* data) const;
+    };
+
+private:
+    std::unique_ptr<unsigned char[], AlignedDeleter> m_data;
+    ImageView m_view;
+};
+
+} // namespace png_decoder::image_view
@@ -17,15 +17,208 @@ Inflate::~Inflate() {
 }
 
 std::vector<unsigned char> Inflate::doInflate(const std::vector<unsigned char>& source) {
+    return tryInflate(source).value();
+}
+
+void Inflate::doInflate(const std::vector<unsigned char>& source, const Consumer& consumer) {
+    tryInflate(source, [&consumer](const unsigned char* buffer, size_t size) {
+        consumer(buffer, size);
+        return true;
+    }).value();
+}
+
+Expected<std::vector<unsigned char>> Inflate::tryInflate(const std::vector<unsigned char>& source) {
     std::vector<unsigned char> result;
-    int ret = inf(source, result);
-    checkZlibError(ret);
+    PNG_DECODER_TRY(tryInflate(source, [this, &result](const unsigned char* buffer, size_t size) {
+        insertInflatedBytes(buffer, size, result);
+        return true;
+    }));
+    return result;
+}
+
+Expected<void> Inflate::tryInflate(const std::vector<unsigned char>& source, const LimitedConsumer& consumer) {
+    const int ret = inf(source, consumer);
+    if (ret != Z_OK) {
+        return zlibError(ret);
+    }
+    return {};
+}
+
+Expected<Inflate::SegmentResult> Inflate::doInflateSegment(const unsigned char* source, size_t sourceSize,
+                                                           unsigned char* dest, size_t destSize, bool hasHeader) {
+    m_strm.zalloc = Z_NULL;
+    m_strm.zfree = Z_NULL;
+    m_strm.opaque = Z_NULL;
+    m_strm.avail_in = 0;
+    m_strm.next_in = Z_NULL;
+    // negative window bits stand for raw deflate data without zlib header and trailer
+    if (const int ret = inflateInit2(&m_strm, hasHeader ? MAX_WBITS : -MAX_WBITS); ret != Z_OK) {
+        return zlibError(ret);
+    }
 
+    m_strm.next_in = const_cast<unsigned char*>(source);
+    m_strm.avail_in = sourceSize;
+    m_strm.next_out = dest;
+    m_strm.avail_out = destSize;
+
+    int ret = Z_OK;
+    while (ret == Z_OK && m_strm.avail_out > 0 && m_strm.avail_in > 0) {
+        ret = ::inflate(&m_strm, Z_SYNC_FLUSH);
+    }
+
+    if (ret == Z_NEED_DICT) {
+        ret = Z_DATA_ERROR;
+    }
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+        return zlibError(ret);
+    }
+
+    SegmentResult result{};
+    result.inflated = destSize - m_strm.avail_out;
+    result.consumed = sourceSize - m_strm.avail_in;
+    result.streamEnd = (ret == Z_STREAM_END);
     return result;
 }
 
+void Inflate::doInflateIndexed(const std::vector<unsigned char>& source, const Consumer& consumer,
+                               const std::function<void()>& onBlockBoundary) {
+    tryInflateIndexed(
+        source,
+        [&consumer](const unsigned char* buffer, size_t size) {
+            consumer(buffer, size);
+            return true;
+        },
+        [&onBlockBoundary]() {
+            onBlockBoundary();
+            return true;
+        }).value();
+}
+
+Expected<void> Inflate::tryInflateIndexed(const std::vector<unsigned char>& source, const LimitedConsumer& consumer,
+                                          const std::function<bool()>& onBlockBoundary) {
+    unsigned char out[CHUNK_SIZE];
+
+    m_strm.zalloc = Z_NULL;
+    m_strm.zfree = Z_NULL;
+    m_strm.opaque = Z_NULL;
+    m_strm.avail_in = 0;
+    m_strm.next_in = Z_NULL;
+    if (const int ret = inflateInit(&m_strm); ret != Z_OK) {
+        return zlibError(ret);
+    }
+
+    m_strm.next_in = const_cast<unsigned char*>(source.data());
+    m_strm.avail_in = source.size();
+
+    int ret = Z_OK;
+    do {
+        m_strm.next_out = out;
+        m_strm.avail_out = CHUNK_SIZE;
+
+        // Z_BLOCK makes inflate return at the end of every deflate block
+        ret = ::inflate(&m_strm, Z_BLOCK);
+        if (ret == Z_NEED_DICT || (ret == Z_BUF_ERROR && m_strm.avail_in == 0)) {
+            ret = Z_DATA_ERROR;
+        }
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            return zlibError(ret);
+        }
+
+        if (!consumer(out, CHUNK_SIZE - m_strm.avail_out)) {
+            return {};
+        }
+
+        /*
+        * bit 128 - inflate stopped right after the end of a block (or after zlib header),
+        * bit 64 - the last block of the stream is being decoded
+        */
+        if ((m_strm.data_type & 128) && !(m_strm.data_type & 64) && !onBlockBoundary()) {
+            return {};
+        }
+    } while (ret != Z_STREAM_END);
+    return {};
+}
+
+Inflate::AccessPoint Inflate::accessPoint() {
+    return tryAccessPoint().value();
+}
+
+Expected<Inflate::AccessPoint> Inflate::tryAccessPoint() {
+    AccessPoint point{};
+    point.inputOffset = m_strm.total_in;
+    point.bits = m_strm.data_type & 7;
+
+    point.window.resize(WINDOW_SIZE);
+    uInt windowSize = WINDOW_SIZE;
+    if (const int ret = inflateGetDictionary(&m_strm, point.window.data(), &windowSize); ret != Z_OK) {
+        return zlibError(ret);
+    }
+    point.window.resize(windowSize);
+
+    return point;
+}
+
+void Inflate::doInflateFrom(const std::vector<unsigned char>& source, const AccessPoint& point, const LimitedConsumer& consumer) {
+    tryInflateFrom(source, point, consumer).value();
+}
+
+Expected<void> Inflate::tryInflateFrom(const std::vector<unsigned char>& source, const AccessPoint& point,
+                                       const LimitedConsumer& consumer) {
+    unsigned char out[CHUNK_SIZE];
+
+    // access points may come from untrusted sidecar files
+    if (point.inputOffset > source.size() || point.bits < 0 || point.bits > MAX_ACCESS_POINT_BITS ||
+            (point.bits > 0 && point.inputOffset == 0) || point.window.size() > WINDOW_SIZE) {
+        return DecodeError{DecodeErrorCode::InvalidDeflateData};
+    }
+
+    m_strm.zalloc = Z_NULL;
+    m_strm.zfree = Z_NULL;
+    m_strm.opaque = Z_NULL;
+    m_strm.avail_in = 0;
+    m_strm.next_in = Z_NULL;
+    // raw inflate: the stream is entered in the middle, past the zlib header
+    if (const int ret = inflateInit2(&m_strm, -MAX_WBITS); ret != Z_OK) {
+        return zlibError(ret);
+    }
 
-int Inflate::inf(const std::vector<unsigned char>& source, std::vector<unsigned char>& dest) {
+    if (point.bits > 0) {
+        const int byte = source[point.inputOffset - 1];
+        if (const int ret = inflatePrime(&m_strm, point.bits, byte >> (8 - point.bits)); ret != Z_OK) {
+            return zlibError(ret);
+        }
+    }
+    if (!point.window.empty()) {
+        if (const int ret = inflateSetDictionary(&m_strm, point.window.data(), point.window.size()); ret != Z_OK) {
+            return zlibError(ret);
+        }
+    }
+
+    m_strm.next_in = const_cast<unsigned char*>(source.data()) + point.inputOffset;
+    m_strm.avail_in = source.size() - point.inputOffset;
+
+    int ret = Z_OK;
+    do {
+        m_strm.next_out = out;
+        m_strm.avail_out = CHUNK_SIZE;
+
+        ret = ::inflate(&m_strm, Z_NO_FLUSH);
+        if (ret == Z_NEED_DICT || (ret == Z_BUF_ERROR && m_strm.avail_in == 0)) {
+            ret = Z_DATA_ERROR;
+        }
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            return zlibError(ret);
+        }
+
+        if (!consumer(out, CHUNK_SIZE - m_strm.avail_out)) {
+            return {};
+        }
+    } while (ret != Z_STREAM_END);
+    return {};
+}
+
+
+int Inflate::inf(const std::vector<unsigned char>& source, const LimitedConsumer& consumer) {
     int ret;
     uint32_t have;
     size_t sourceCurrentIndex = 0;
@@ -72,7 +265,9 @@ int Inflate::inf(const std::vector<unsigned char>& source, std::vector<unsigned
             }
 
             have = CHUNK_SIZE - m_strm.avail_out;
-            insertInflatedBytes(out, have, dest);
+            if (!consumer(out, have)) {
+                return Z_OK;
+            }
 
         } while (m_strm.avail_out == 0);
 
@@ -83,16 +278,16 @@ int Inflate::inf(const std::vector<unsigned char>& source, std::vector<unsigned
 }
 
 
-void Inflate::checkZlibError(int ret) {
+DecodeError Inflate::zlibError(int ret) {
     switch (ret) {
-    case Z_STREAM_ERROR:
-        throw exceptions::ZlibInvalidCompressionLevelException();
-    case Z_DATA_ERROR:
-        throw exceptions::ZlibInvalidDeflateDataException();
     case Z_MEM_ERROR:
-        throw exceptions::ZlibOutOfMemoryException();
+        return DecodeError{DecodeErrorCode::ZlibOutOfMemory};
+    case Z_STREAM_ERROR:
+        return DecodeError{DecodeErrorCode::ZlibStreamError};
     case Z_VERSION_ERROR:
-        throw exceptions::ZlibVersionMismatchException();
+        return DecodeError{DecodeErrorCode::ZlibVersionMismatch};
+    default:
+        return DecodeError{DecodeErrorCode::InvalidDeflateData};
     }
 }
 
@@ -101,15 +296,15 @@ std::size_t Inflate::readFromVector(unsigned char* buffer, size_t bufferSize, co
     size_t left = (start <= source.size()) ? source.size() - start : 0;
     size_t available = std::min(bufferSize, left);
 
-    std::memcpy(buffer, source.data() + start, available);
+    if (available > 0) {
+        std::memcpy(buffer, source.data() + start, available);
+    }
     return available;
 }
 
 void Inflate::insertInflatedBytes(const unsigned char* buffer, size_t have, std::vector<unsigned char>& dest) {
-    dest.reserve(dest.size() + have);
-    for (size_t i = 0; i < have; ++i) {
-        dest.push_back(buffer[i]);
-    }
+    // reserving the exact size on every chunk would reallocate every time, `insert` grows geometrically
+    dest.insert(dest.end(), buffer, buffer + have);
 }
 
 
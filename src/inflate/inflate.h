@@ -2,19 +2,72 @@
 
 #include <cstdint>
 #include <vector>
+#include <functional>
 #include <zlib.h>
 
 #include "exceptions/exceptions.h"
+#include "misc/expected.h"
 
 
 namespace png_decoder::inflate {
 
 class Inflate {
 public:
+    /* receives every block of inflated bytes as soon as zlib produces it */
+    using Consumer = std::function<void(const unsigned char* buffer, size_t size)>;
+
+    /* receives inflated bytes, returning false stops inflating */
+    using LimitedConsumer = std::function<bool(const unsigned char* buffer, size_t size)>;
+
+    struct SegmentResult {
+        size_t inflated = 0;
+        size_t consumed = 0;
+        bool streamEnd = false;
+    };
+
+    /* state needed to resume inflating from a deflate block boundary, see zlib's examples/zran.c */
+    struct AccessPoint {
+        // offset of the first source byte not fully consumed
+        size_t inputOffset = 0;
+        // count of bits of the byte at `inputOffset - 1` not consumed yet
+        int bits = 0;
+        // last (up to 32K) inflated bytes
+        std::vector<unsigned char> window;
+    };
+    // bounds of valid access points: less than a byte of pending bits and a single window
+    static constexpr int MAX_ACCESS_POINT_BITS = 7;
+    static constexpr size_t WINDOW_SIZE = 32768;
+
     Inflate();
     ~Inflate();
 
     std::vector<unsigned char> doInflate(const std::vector<unsigned char>& source);
+    void doInflate(const std::vector<unsigned char>& source, const Consumer& consumer);
+    /* same as `doInflate`, returning zlib errors instead of throwing them; the consumer returning false stops inflating */
+    Expected<std::vector<unsigned char>> tryInflate(const std::vector<unsigned char>& source);
+    Expected<void> tryInflate(const std::vector<unsigned char>& source, const LimitedConsumer& consumer);
+    /*
+    * Inflates a part of a deflate stream which starts at a block boundary with an empty window
+    * (i.e. right after a full flush) directly into `dest`. Only the first part of a zlib stream has
+    * the zlib header. Stops once `dest` is full, the source is consumed, or the stream ends.
+    */
+    Expected<SegmentResult> doInflateSegment(const unsigned char* source, size_t sourceSize,
+                                             unsigned char* dest, size_t destSize, bool hasHeader);
+    /*
+    * Inflates the whole zlib stream, invoking `onBlockBoundary` after every deflate block once all of its
+    * bytes are passed to the consumer. `accessPoint` may be called from the callback.
+    */
+    void doInflateIndexed(const std::vector<unsigned char>& source, const Consumer& consumer,
+                          const std::function<void()>& onBlockBoundary);
+    /* same as `doInflateIndexed`, returning zlib errors; the consumer or the callback returning false stops inflating */
+    Expected<void> tryInflateIndexed(const std::vector<unsigned char>& source, const LimitedConsumer& consumer,
+                                     const std::function<bool()>& onBlockBoundary);
+    AccessPoint accessPoint();
+    Expected<AccessPoint> tryAccessPoint();
+    /* resumes inflating the zlib stream in `source` from the access point */
+    void doInflateFrom(const std::vector<unsigned char>& source, const AccessPoint& point, const LimitedConsumer& consumer);
+    Expected<void> tryInflateFrom(const std::vector<unsigned char>& source, const AccessPoint& point,
+                                  const LimitedConsumer& consumer);
 
 private:
     /* Decompress from source to dest.
@@ -22,10 +75,9 @@ private:
     allocated for processing, Z_DATA_ERROR if the deflate data is
     invalid or incomplete, Z_VERSION_ERROR if the version of zlib.h and
     the version of the library linked do not match. */
-    int inf(const std::vector<unsigned char>& source, std::vector<unsigned char>& dest);
+    int inf(const std::vector<unsigned char>& source, const LimitedConsumer& consumer);
 
-    /* wrap zlib error into exception */
-    void checkZlibError(int ret);
+    static DecodeError zlibError(int ret);
     std::size_t readFromVector(unsigned char* buffer, size_t bufferSize, const std::vector<unsigned char>& source, size_t start);
     void insertInflatedBytes(const unsigned char* buffer, size_t have, std::vector<unsigned char>& dest);
 
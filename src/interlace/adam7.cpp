@@ -0,0 +1,53 @@
+#include <cstring>
+
+#include "adam7.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+namespace png_decoder::interlace {
+
+uint32_t passWidth(const Adam7Pass& pass, uint32_t width) {
+    return (static_cast<uint64_t>(width) + pass.colIncrement - pass.startCol - 1) / pass.colIncrement;
+}
+
+
+uint32_t passHeight(const Adam7Pass& pass, uint32_t height) {
+    return (static_cast<uint64_t>(height) + pass.rowIncrement - pass.startRow - 1) / pass.rowIncrement;
+}
+
+
+void interleavePixels(const unsigned char* even, size_t evenCount, const unsigned char* odd, size_t oddCount,
+                      size_t pixelSize, unsigned char* out) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 8-bit and 16-bit packed pixels: one load of each input yields two stores of interleaved pixels
+    if (pixelSize == 4) {
+        for (; i + 4 <= oddCount; i += 4) {
+            const __m128i evenPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(even + 4 * i));
+            const __m128i oddPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(odd + 4 * i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8 * i), _mm_unpacklo_epi32(evenPixels, oddPixels));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8 * i + 16), _mm_unpackhi_epi32(evenPixels, oddPixels));
+        }
+    }
+    else if (pixelSize == 8) {
+        for (; i + 2 <= oddCount; i += 2) {
+            const __m128i evenPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(even + 8 * i));
+            const __m128i oddPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(odd + 8 * i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * i), _mm_unpacklo_epi64(evenPixels, oddPixels));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * i + 16), _mm_unpackhi_epi64(evenPixels, oddPixels));
+        }
+    }
+#endif
+    for (; i < oddCount; ++i) {
+        std::memcpy(out + 2 * i * pixelSize, even + i * pixelSize, pixelSize);
+        std::memcpy(out + (2 * i + 1) * pixelSize, odd + i * pixelSize, pixelSize);
+    }
+    if (evenCount > oddCount) {
+        std::memcpy(out + 2 * oddCount * pixelSize, even + oddCount * pixelSize, pixelSize);
+    }
+}
+
+} // namespace png_decoder::interlace
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace png_decoder::interlace {
+
+// See: http://www.libpng.org/pub/png/spec/1.2/PNG-DataRep.html#DR.Image-layout
+struct Adam7Pass {
+    uint32_t startRow;
+    uint32_t startCol;
+    uint32_t rowIncrement;
+    uint32_t colIncrement;
+};
+
+constexpr size_t ADAM7_PASSES_COUNT = 7;
+
+constexpr std::array<Adam7Pass, ADAM7_PASSES_COUNT> ADAM7_PASSES = {{
+    {0, 0, 8, 8},
+    {0, 4, 8, 8},
+    {4, 0, 8, 4},
+    {0, 2, 4, 4},
+    {2, 0, 4, 2},
+    {0, 1, 2, 2},
+    {1, 0, 2, 1},
+}};
+
+// rows of the image are filled by passes according to their position in a block of `ADAM7_BLOCK_SIZE` rows
+constexpr uint32_t ADAM7_BLOCK_SIZE = 8;
+
+/*
+* Columns of the image filled by passes (or by a single pass) present in a row are never sparse, they just interleave:
+*   odd rows: pass 7 holds the whole row,
+*   rows 2 and 6 of a block: pass 5 holds even columns, pass 6 odd ones,
+*   row 4: even columns interleave passes 3 (columns 0 mod 4) and 4 (2 mod 4), odd ones are pass 6,
+*   row 0: columns 0 mod 4 interleave passes 1 and 2 and are interleaved with pass 4, odd ones are pass 6.
+* So every row is assembled from contiguous pass rows with at most three `interleavePixels` calls.
+*/
+
+/* number of pixels the pass has in every row (or column) of the image of the given width (or height) */
+uint32_t passWidth(const Adam7Pass& pass, uint32_t width);
+uint32_t passHeight(const Adam7Pass& pass, uint32_t height);
+
+/*
+* Writes `out[2k] = even[k]` and `out[2k + 1] = odd[k]` for pixels of `pixelSize` bytes,
+* `evenCount` is either `oddCount` or `oddCount + 1`.
+*/
+void interleavePixels(const unsigned char* even, size_t evenCount, const unsigned char* odd, size_t oddCount,
+                      size_t pixelSize, unsigned char* out);
+
+} // namespace png_decoder::interlace
@@ -0,0 +1,88 @@
+#include "decode_error.h"
+#include "utils/utils.h"
+
+
+namespace png_decoder {
+
+std::string DecodeError::message() const {
+    const std::string first = std::to_string(values[0]);
+    const std::string second = std::to_string(values[1]);
+    std::string chunk = "'";
+    chunk.append(utils::stringifyChunkType(chunkType)).append("'");
+
+    switch (code) {
+    case DecodeErrorCode::InvalidSignature:
+        return "Invalid signature";
+    case DecodeErrorCode::MissingIHDR:
+        return "Invalid IHDR chunk";
+    case DecodeErrorCode::InvalidIHDRLength:
+        return "Invalid IHDR chunk length: " + first;
+    case DecodeErrorCode::InvalidImageSize:
+        return "Invalid image size: " + first + "x" + second;
+    case DecodeErrorCode::UnsupportedColorType:
+        return "Unsupported color type in IHDR: " + first;
+    case DecodeErrorCode::UnsupportedBitDepth:
+        return "Unsupported bit depth " + first + " for color type " + second;
+    case DecodeErrorCode::UnsupportedCompressionMethod:
+        return "Unsupported compression method " + first + " or filter method " + second;
+    case DecodeErrorCode::InvalidInterlaceMethod:
+        return "Invalid interlace method: " + first;
+    case DecodeErrorCode::ImageTooWide:
+        return "Image width is too large: " + first;
+    case DecodeErrorCode::InvalidPLTELength:
+        return "Invalid PLTE chunk length: " + first;
+    case DecodeErrorCode::MultiplePLTE:
+        return "Multiple PLTE chunks";
+    case DecodeErrorCode::MissingPLTE:
+        return "Missing PLTE chunk of palette image";
+    case DecodeErrorCode::InvalidIEND:
+        return "Invalid IEND chunk";
+    case DecodeErrorCode::InvalidCRC:
+        return "Invalid CRC chunk type " + chunk + ": actual=" + first + ", expected=" + second;
+    case DecodeErrorCode::InvalidChunkLength:
+        return "Invalid chunk length " + first;
+    case DecodeErrorCode::TruncatedStream:
+        return (chunkType == 0) ? "Stream ends before the IEND chunk" : "Stream ends within chunk " + chunk;
+    case DecodeErrorCode::ImageDataTooSmall:
+        return "Image data of " + first + " bytes cannot hold an image of " + second + " bytes";
+    case DecodeErrorCode::InvalidDeflateData:
+        return "zlib: invalid or incomplete deflate data";
+    case DecodeErrorCode::ZlibOutOfMemory:
+        return "zlib: out of memory";
+    case DecodeErrorCode::ZlibStreamError:
+        return "zlib: invalid compression level";
+    case DecodeErrorCode::ZlibVersionMismatch:
+        return "zlib: zlib version mismatch";
+    case DecodeErrorCode::TruncatedImageData:
+        return "Image data ends at row " + first + " of " + second;
+    case DecodeErrorCode::TruncatedAdam7Pass:
+        return "Image data of " + first + " bytes ends in Adam7 pass " + second;
+    case DecodeErrorCode::InvalidFilterType:
+        return "Invalid filter type " + first + " of row " + second;
+    case DecodeErrorCode::PaletteIndexOfNonPaletteImage:
+        return "Palette indices requested from image of color type " + first;
+    case DecodeErrorCode::RowIndexOfInterlacedImage:
+        return "Row index requires non-interlaced image";
+    case DecodeErrorCode::RowIndexMismatch:
+        return "Row index does not match the image";
+    case DecodeErrorCode::InvalidRowsRange:
+        return "Invalid rows range [" + first + ", " + second + ")";
+    case DecodeErrorCode::MissingRowCheckpoint:
+        return "Row index has no checkpoint before row " + first;
+    case DecodeErrorCode::InvalidRowCheckpoint:
+        return "Row index checkpoint of " + first + " bytes does not match scanline size " + second;
+    case DecodeErrorCode::TooManyPixels:
+        return "Image of " + first + " pixels exceeds the limit of " + second;
+    case DecodeErrorCode::TooManyInflatedBytes:
+        return "Image data inflates into " + first + " bytes, more than the limit of " + second;
+    case DecodeErrorCode::TooManyChunks:
+        return "Chunks exceed the limit of " + second;
+    case DecodeErrorCode::ChunkTooLong:
+        return "Chunk " + chunk + " of " + first + " bytes exceeds the limit of " + second;
+    case DecodeErrorCode::TooMuchMemory:
+        return "Decoding requires " + first + " bytes of memory, more than the limit of " + second;
+    }
+    return "Unknown decoding error";
+}
+
+} // namespace png_decoder
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+
+namespace png_decoder {
+
+// reasons a PNG image is rejected, the comments list `DecodeError::values` of every code
+enum class DecodeErrorCode : uint8_t {
+    InvalidSignature = 1,
+    // the first chunk is not IHDR
+    MissingIHDR,
+    // chunk length
+    InvalidIHDRLength,
+    // width, height
+    InvalidImageSize,
+    // color type
+    UnsupportedColorType,
+    // bit depth, color type
+    UnsupportedBitDepth,
+    // compression method, filter method
+    UnsupportedCompressionMethod,
+    // interlace method
+    InvalidInterlaceMethod,
+    // width
+    ImageTooWide,
+    // chunk length
+    InvalidPLTELength,
+    MultiplePLTE,
+    MissingPLTE,
+    // data follows the IEND chunk
+    InvalidIEND,
+    // computed CRC, stored CRC
+    InvalidCRC,
+    // chunk length
+    InvalidChunkLength,
+    // the stream ends within the chunk (`DecodeError::chunkType`), or before a chunk if it is 0
+    TruncatedStream,
+    // size of the image data, size of the defiltered image
+    ImageDataTooSmall,
+    // zlib errors
+    InvalidDeflateData,
+    ZlibOutOfMemory,
+    ZlibStreamError,
+    ZlibVersionMismatch,
+    // row the image data ends at, height of the image
+    TruncatedImageData,
+    // size of the image data, Adam7 pass it ends in
+    TruncatedAdam7Pass,
+    // filter type, row
+    InvalidFilterType,
+    // color type; palette indices were requested (`SampleType::PaletteIndex`) from an image without a palette
+    PaletteIndexOfNonPaletteImage,
+    // row indices are built and used for non-interlaced images only
+    RowIndexOfInterlacedImage,
+    // the row index was built for another image
+    RowIndexMismatch,
+    // first row, last row of the range decoded with a row index
+    InvalidRowsRange,
+    // row the row index has no checkpoint at or before
+    MissingRowCheckpoint,
+    // size of the row prefix or of the previous scanline stored in a checkpoint, scanline size
+    InvalidRowCheckpoint,
+    // the rest are `DecodeLimits` exceeded: the amount requested, the limit
+    // pixels of the image
+    TooManyPixels,
+    // inflated bytes, counted up to the first block past the limit
+    TooManyInflatedBytes,
+    // chunks
+    TooManyChunks,
+    // length of the chunk
+    ChunkTooLong,
+    // bytes of memory
+    TooMuchMemory,
+};
+
+
+/*
+* Compact description of a rejected image. Constructing and returning it never allocates: the text is built
+* by `message` only when someone asks for it, which is what makes rejecting corrupt files cheap.
+*/
+struct DecodeError {
+    DecodeErrorCode code = DecodeErrorCode::InvalidSignature;
+    // chunk being read when the error occurred, 0 if not known
+    uint32_t chunkType = 0;
+    std::array<uint64_t, 2> values{};
+
+    std::string message() const;
+};
+
+} // namespace png_decoder
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <utility>
+#include <variant>
+
+#include "misc/decode_error.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder {
+
+/*
+* Either a value or the `DecodeError` which prevented computing it, for callers who would rather check
+* than catch (std::expected is C++23). `value()` of a failed result throws the exception the throwing API
+* throws for the same error, which is how that API is implemented on top of this one.
+*/
+template <class T>
+class Expected {
+public:
+    Expected(T value) : m_state{std::in_place_index<0>, std::move(value)} {}
+    Expected(DecodeError error) : m_state{std::in_place_index<1>, error} {}
+
+    bool hasValue() const noexcept {
+        return m_state.index() == 0;
+    }
+
+    explicit operator bool() const noexcept {
+        return hasValue();
+    }
+
+    T& value() & {
+        throwIfError();
+        return std::get<0>(m_state);
+    }
+
+    const T& value() const& {
+        throwIfError();
+        return std::get<0>(m_state);
+    }
+
+    T&& value() && {
+        throwIfError();
+        return std::get<0>(std::move(m_state));
+    }
+
+    T& operator*() noexcept {
+        return *std::get_if<0>(&m_state);
+    }
+
+    const T& operator*() const noexcept {
+        return *std::get_if<0>(&m_state);
+    }
+
+    T* operator->() noexcept {
+        return std::get_if<0>(&m_state);
+    }
+
+    const T* operator->() const noexcept {
+        return std::get_if<0>(&m_state);
+    }
+
+    /* only valid if there is no value */
+    const DecodeError& error() const noexcept {
+        return *std::get_if<1>(&m_state);
+    }
+
+private:
+    void throwIfError() const {
+        if (!hasValue()) {
+            exceptions::throwDecodeError(error());
+        }
+    }
+
+private:
+    std::variant<T, DecodeError> m_state;
+};
+
+
+template <>
+class Expected<void> {
+public:
+    Expected() : m_failed{false}, m_error{} {}
+    Expected(DecodeError error) : m_failed{true}, m_error{error} {}
+
+    bool hasValue() const noexcept {
+        return !m_failed;
+    }
+
+    explicit operator bool() const noexcept {
+        return hasValue();
+    }
+
+    void value() const {
+        if (m_failed) {
+            exceptions::throwDecodeError(m_error);
+        }
+    }
+
+    const DecodeError& error() const noexcept {
+        return m_error;
+    }
+
+private:
+    bool m_failed;
+    DecodeError m_error;
+};
+
+
+} // namespace png_decoder
+
+
+/* returns the error of a failed `Expected` expression from the enclosing function returning `Expected` */
+#define PNG_DECODER_TRY(expression)                         \
+    do {                                                    \
+        if (auto&& status_ = (expression); !status_) {      \
+            return status_.error();                         \
+        }                                                   \
+    } while (false)
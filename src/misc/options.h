@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "misc/structs.h"
+#include "misc/orientation.h"
+#include "misc/pixel_format.h"
+#include "reducer/reducer.h"
+
+namespace png_decoder {
+
+using ChunkHandler = std::function<void(const ChunkView& chunk)>;
+
+/*
+* Resources a single image may claim, for decoding untrusted files: a header of a few bytes can declare
+* gigapixels, and a few kilobytes of deflate data can inflate into gigabytes. Every limit is checked before
+* the memory it guards is allocated (the size of the image right after IHDR, chunks before they are read,
+* inflated bytes while inflating), so that such images fail fast with a `DecodeError` (`LimitExceededException`).
+*/
+struct DecodeLimits {
+    // width * height of the image
+    uint64_t maxPixels = std::numeric_limits<uint64_t>::max();
+    // bytes inflated from the image data, filter method bytes included
+    uint64_t maxInflatedBytes = std::numeric_limits<uint64_t>::max();
+    // chunks of the file, IHDR and IEND included
+    uint64_t maxChunksCount = std::numeric_limits<uint64_t>::max();
+    // data bytes of a single chunk
+    uint32_t maxChunkLength = std::numeric_limits<uint32_t>::max();
+    /*
+    * Compressed image data kept by the decoder together with the largest buffer it allocates on decoding
+    * (`Image` of `createImage`, the whole inflated image of interlaced and multithreaded decoding,
+    * checkpoints of `buildRowIndex`).
+    * Memory of caller-provided views and sinks is not counted.
+    */
+    uint64_t maxMemoryBytes = std::numeric_limits<uint64_t>::max();
+};
+
+
+struct DecodeOptions {
+    /*
+    * Threads used to decode a single image. Images whose IDAT stream is split into independently inflatable
+    * segments (iDOT or zsEG chunk) are inflated in parallel. Rows of other large non-interlaced images are defiltered
+    * on one thread and converted in bands on all of them, at the cost of keeping the whole inflated image in memory.
+    * Rows are converted on one thread for sinks not accepting concurrent rows and with reducers.
+    */
+    size_t threadsCount = 1;
+    // layout and color conversion of rows written to sinks accepting packed rows (ignored by other sinks)
+    PixelFormat pixelFormat{};
+    /*
+    * Handlers of ancillary chunks the caller is interested in, keyed by chunk type (e.g. 0x69434350 for iCCP).
+    * Chunks consumed by the decoder itself (IHDR, PLTE, IDAT, IEND, iDOT, zsEG, gAMA, sRGB, cHRM) are never dispatched,
+    * eXIf is dispatched after its orientation is read.
+    * Every other chunk without a handler is skipped without being read into memory.
+    */
+    std::unordered_map<uint32_t, ChunkHandler> chunkHandlers;
+    // skipped chunks are read through (but still not buffered) only when their CRC has to be verified
+    bool verifySkippedChunksCRC = false;
+    /*
+    * Reducers fed with every row written to the sink, the caller keeps them to read the results after decoding.
+    * Rows are reduced in order on one thread, so segments of the image are not defiltered concurrently,
+    * and a reducer must not be shared by images decoded at the same time. Frames of an animation are not reduced.
+    */
+    std::vector<std::shared_ptr<reducer::RowReducer>> reducers;
+    // whether `PNGDecoder::getContentHash` is computed while chunks are parsed
+    bool hashContent = false;
+    /*
+    * Orientation of the stored image: `PNGDecoder::createImage` and decoding into a view write the image upright,
+    * transformed while rows are written. Rows streamed to other sinks, row ranges and animation frames stay as stored.
+    */
+    Orientation orientation = Orientation::TopLeft;
+    // whether the orientation of eXIf chunk, if any, overrides `orientation`
+    bool useExifOrientation = false;
+    DecodeLimits limits{};
+};
+
+} // namespace png_decoder
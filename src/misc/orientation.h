@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace png_decoder {
+
+/*
+* EXIF orientation (tag 0x0112): position of the stored row 0 and column 0 in the upright image.
+* See: https://www.cipa.jp/std/documents/download_e.html?DC-008-Translation-2023-E
+*/
+enum class Orientation : uint8_t {
+    // stored upright
+    TopLeft = 1,
+    // mirrored horizontally
+    TopRight,
+    // rotated by 180 degrees
+    BottomRight,
+    // mirrored vertically
+    BottomLeft,
+    // mirrored along the main diagonal
+    LeftTop,
+    // displayed upright after rotating 90 degrees clockwise
+    RightTop,
+    // mirrored along the anti-diagonal
+    RightBottom,
+    // displayed upright after rotating 90 degrees counterclockwise
+    LeftBottom,
+};
+
+// whether stored rows become columns of the upright image
+inline bool isTransposing(Orientation orientation) {
+    return orientation >= Orientation::LeftTop;
+}
+
+// size of the upright image
+inline uint32_t orientedWidth(Orientation orientation, uint32_t width, uint32_t height) {
+    return isTransposing(orientation) ? height : width;
+}
+
+inline uint32_t orientedHeight(Orientation orientation, uint32_t width, uint32_t height) {
+    return isTransposing(orientation) ? width : height;
+}
+
+} // namespace png_decoder
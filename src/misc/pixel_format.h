@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "image.h"
+
+namespace png_decoder {
+
+// byte order of the four channels of a packed pixel in memory
+enum class ChannelOrder : uint8_t {
+    RGBA = 0,
+    BGRA,
+    ARGB,
+};
+
+enum class AlphaMode : uint8_t {
+    Straight = 0,
+    // color channels are multiplied by alpha / 255
+    Premultiplied,
+};
+
+// type of every sample of a packed pixel, wider types are stored in host byte order
+enum class SampleType : uint8_t {
+    UInt8 = 0,
+    UInt16,
+    // from 0.0 to 1.0
+    Float32,
+    /*
+    * Palette index of the pixel, one byte per pixel whatever the bit depth; the other fields of the format are ignored.
+    * Only palette images can be decoded into packed rows of indices, see `sink::IndexSink`.
+    */
+    PaletteIndex,
+};
+
+// transfer function of color samples of packed pixels, alpha is always linear
+enum class TransferFunction : uint8_t {
+    // samples as stored in the image
+    Encoded = 0,
+    // converted to the sRGB curve according to gAMA / sRGB chunks of the image
+    SRGB,
+    // linear light
+    Linear,
+};
+
+// layout of rows delivered to sinks accepting packed rows, see `sink::RowSink::acceptsPackedRows`
+struct PixelFormat {
+    ChannelOrder channelOrder = ChannelOrder::RGBA;
+    AlphaMode alphaMode = AlphaMode::Straight;
+    SampleType sampleType = SampleType::UInt8;
+    TransferFunction transferFunction = TransferFunction::Encoded;
+};
+
+// size of 8-bit packed pixel
+constexpr uint32_t PACKED_PIXEL_SIZE = 4;
+
+inline size_t packedPixelSize(const PixelFormat& format) {
+    switch (format.sampleType) {
+    case SampleType::UInt8: return PACKED_PIXEL_SIZE;
+    case SampleType::UInt16: return PACKED_PIXEL_SIZE * sizeof(uint16_t);
+    case SampleType::Float32: return PACKED_PIXEL_SIZE * sizeof(float);
+    case SampleType::PaletteIndex: return sizeof(uint8_t);
+    }
+    return PACKED_PIXEL_SIZE;
+}
+
+inline bool isPaletteIndex(const PixelFormat& format) {
+    return format.sampleType == SampleType::PaletteIndex;
+}
+
+// whether pixels of the format are plain 8-bit samples, which only need reordering and premultiplication
+inline bool isEncoded8Bit(const PixelFormat& format) {
+    return format.sampleType == SampleType::UInt8 && format.transferFunction == TransferFunction::Encoded;
+}
+
+
+// round(color * alpha / 255) without division
+inline uint8_t premultiply(uint8_t color, uint8_t alpha) {
+    const uint32_t product = uint32_t(color) * alpha + 128;
+    return (product + (product >> 8)) >> 8;
+}
+
+// `packPixel` and `packPixels` write 8-bit pixels ignoring sample type and transfer function of the format
+inline void packPixel(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha, const PixelFormat& format, unsigned char* out) {
+    if (format.alphaMode == AlphaMode::Premultiplied) {
+        red = premultiply(red, alpha);
+        green = premultiply(green, alpha);
+        blue = premultiply(blue, alpha);
+    }
+
+    switch (format.channelOrder) {
+    case ChannelOrder::RGBA: out[0] = red; out[1] = green; out[2] = blue; out[3] = alpha; break;
+    case ChannelOrder::BGRA: out[0] = blue; out[1] = green; out[2] = red; out[3] = alpha; break;
+    case ChannelOrder::ARGB: out[0] = alpha; out[1] = red; out[2] = green; out[3] = blue; break;
+    }
+}
+
+inline void packPixels(const std::vector<RGB>& pixels, const PixelFormat& format, unsigned char* out) {
+    for (const RGB& pixel : pixels) {
+        packPixel(pixel.r, pixel.g, pixel.b, pixel.a, format, out);
+        out += PACKED_PIXEL_SIZE;
+    }
+}
+
+} // namespace png_decoder
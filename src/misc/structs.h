@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <cstdint>
+#include <cstddef>
 
 namespace png_decoder {
 
@@ -25,15 +26,31 @@ struct PLTE {
         uint8_t blue = 0;
     };
 
-    uint8_t length;
+    // length of the chunk in bytes, up to 3 * 256
+    uint32_t length = 0;
     std::vector<rgb> palette;
+    // alpha of the first palette entries from tRNS chunk, the entries past its end are opaque
+    std::vector<uint8_t> alpha;
 };
 
-struct Chunk {
+struct ChunkHeader {
     uint32_t length = 0;
     uint32_t type = 0;
-    std::vector<unsigned char> data{};
-    uint32_t crc = 0;
+};
+
+// non-owning view of chunk data, valid only while the chunk is being handled
+struct ChunkView {
+    uint32_t type = 0;
+    const unsigned char* data = nullptr;
+    uint32_t length = 0;
+};
+
+// part of IDAT stream that can be inflated independently (i.e. starting after a full flush)
+struct ImageSegment {
+    uint32_t firstRow = 0;
+    uint32_t rowsCount = 0;
+    // offset in the concatenated IDAT data
+    size_t dataOffset = 0;
 };
 
 struct Scanline {
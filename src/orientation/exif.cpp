@@ -0,0 +1,111 @@
+#include <cstdint>
+#include <cstring>
+
+#include "exif.h"
+
+
+namespace png_decoder::orientation {
+
+namespace {
+
+constexpr uint16_t TIFF_MAGIC = 42;
+constexpr uint16_t ORIENTATION_TAG = 0x0112;
+constexpr uint16_t SHORT_TYPE = 3;
+constexpr size_t TIFF_HEADER_SIZE = 8;
+constexpr size_t IFD_ENTRY_SIZE = 12;
+
+// some encoders keep the "Exif\0\0" prefix of the JPEG APP1 segment, which eXIf must not contain
+constexpr unsigned char JPEG_EXIF_PREFIX[] = {'E', 'x', 'i', 'f', 0, 0};
+
+class TiffReader {
+public:
+    TiffReader(const unsigned char* data, size_t size, bool bigEndian)
+        : m_data{data}
+        , m_size{size}
+        , m_bigEndian{bigEndian} {}
+
+    bool readU16(size_t offset, uint16_t& value) const {
+        if (offset > m_size || m_size - offset < 2) {
+            return false;
+        }
+        const unsigned char* bytes = m_data + offset;
+        value = m_bigEndian
+            ? static_cast<uint16_t>((bytes[0] << 8) | bytes[1])
+            : static_cast<uint16_t>((bytes[1] << 8) | bytes[0]);
+        return true;
+    }
+
+    bool readU32(size_t offset, uint32_t& value) const {
+        uint16_t first = 0;
+        uint16_t second = 0;
+        if (!readU16(offset, first) || !readU16(offset + 2, second)) {
+            return false;
+        }
+        value = m_bigEndian
+            ? (static_cast<uint32_t>(first) << 16) | second
+            : (static_cast<uint32_t>(second) << 16) | first;
+        return true;
+    }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    bool m_bigEndian;
+};
+
+} // namespace
+
+std::optional<Orientation> parseExifOrientation(const unsigned char* data, size_t size) {
+    if (size >= sizeof(JPEG_EXIF_PREFIX) && std::memcmp(data, JPEG_EXIF_PREFIX, sizeof(JPEG_EXIF_PREFIX)) == 0) {
+        data += sizeof(JPEG_EXIF_PREFIX);
+        size -= sizeof(JPEG_EXIF_PREFIX);
+    }
+    if (size < TIFF_HEADER_SIZE) {
+        return std::nullopt;
+    }
+
+    bool bigEndian = false;
+    if (data[0] == 'M' && data[1] == 'M') {
+        bigEndian = true;
+    }
+    else if (data[0] != 'I' || data[1] != 'I') {
+        return std::nullopt;
+    }
+    const TiffReader reader(data, size, bigEndian);
+
+    uint16_t magic = 0;
+    uint32_t ifdOffset = 0;
+    uint16_t entriesCount = 0;
+    if (!reader.readU16(2, magic) || magic != TIFF_MAGIC
+        || !reader.readU32(4, ifdOffset) || !reader.readU16(ifdOffset, entriesCount)) {
+        return std::nullopt;
+    }
+
+    // entries are sorted by tag, but some writers do not sort them, so all of them are scanned
+    for (size_t i = 0; i < entriesCount; ++i) {
+        const size_t entryOffset = static_cast<size_t>(ifdOffset) + 2 + i * IFD_ENTRY_SIZE;
+        uint16_t tag = 0;
+        uint16_t type = 0;
+        uint32_t count = 0;
+        uint16_t value = 0;
+        if (!reader.readU16(entryOffset, tag)) {
+            return std::nullopt;
+        }
+        if (tag != ORIENTATION_TAG) {
+            continue;
+        }
+        // a single SHORT is stored in the first bytes of the value field
+        if (!reader.readU16(entryOffset + 2, type) || type != SHORT_TYPE
+            || !reader.readU32(entryOffset + 4, count) || count != 1
+            || !reader.readU16(entryOffset + 8, value)) {
+            return std::nullopt;
+        }
+        if (value < static_cast<uint16_t>(Orientation::TopLeft) || value > static_cast<uint16_t>(Orientation::LeftBottom)) {
+            return std::nullopt;
+        }
+        return static_cast<Orientation>(value);
+    }
+    return std::nullopt;
+}
+
+} // namespace png_decoder::orientation
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+
+#include "misc/orientation.h"
+
+
+namespace png_decoder::orientation {
+
+/*
+* Orientation tag of IFD0 of the EXIF data of eXIf chunk (TIFF structure, either byte order),
+* empty if the data is malformed or has no valid orientation.
+* See: https://ftp-osl.osuosl.org/pub/libpng/documents/pngext-1.5.0.html#C.eXIf
+*/
+std::optional<Orientation> parseExifOrientation(const unsigned char* data, size_t size);
+
+} // namespace png_decoder::orientation
@@ -0,0 +1,165 @@
+#include <cstring>
+
+#include "oriented_writer.h"
+
+
+namespace png_decoder::orientation {
+
+namespace {
+
+// constant pixel sizes turn the per-pixel `memcpy` into a single move, 0 stands for any other size
+template <size_t PIXEL_SIZE>
+void reversePixels(unsigned char* row, uint32_t width, size_t pixelSize) {
+    const size_t size = (PIXEL_SIZE != 0) ? PIXEL_SIZE : pixelSize;
+    unsigned char pixel[16];
+    unsigned char* left = row;
+    unsigned char* right = row + (static_cast<size_t>(width) - 1) * size;
+    while (left < right) {
+        std::memcpy(pixel, left, size);
+        std::memcpy(left, right, size);
+        std::memcpy(right, pixel, size);
+        left += size;
+        right -= size;
+    }
+}
+
+template <size_t PIXEL_SIZE>
+void copyReversedPixels(unsigned char* target, const unsigned char* pixels, uint32_t width, size_t pixelSize) {
+    const size_t size = (PIXEL_SIZE != 0) ? PIXEL_SIZE : pixelSize;
+    const unsigned char* source = pixels + (static_cast<size_t>(width) - 1) * size;
+    for (uint32_t i = 0; i < width; ++i, target += size, source -= size) {
+        std::memcpy(target, source, size);
+    }
+}
+
+/*
+* Column `x` of the band becomes a run of `rowsCount` pixels of destination row `x` (or `width - 1 - x`),
+* with band rows reversed for orientations whose stored top row ends up on the right.
+*/
+template <size_t PIXEL_SIZE>
+void transposePixels(const unsigned char* band, size_t rowSize, uint32_t rowsCount, uint32_t width,
+                     unsigned char* destination, size_t stride, size_t pixelSize,
+                     bool reverseRows, bool reverseColumns) {
+    const size_t size = (PIXEL_SIZE != 0) ? PIXEL_SIZE : pixelSize;
+    const unsigned char* firstRow = reverseRows ? band + (rowsCount - 1) * rowSize : band;
+    const ptrdiff_t rowStep = reverseRows ? -static_cast<ptrdiff_t>(rowSize) : static_cast<ptrdiff_t>(rowSize);
+    for (uint32_t x = 0; x < width; ++x) {
+        unsigned char* out = destination + static_cast<size_t>(reverseColumns ? width - 1 - x : x) * stride;
+        const unsigned char* in = firstRow + static_cast<size_t>(x) * size;
+        for (uint32_t i = 0; i < rowsCount; ++i, out += size, in += rowStep) {
+            std::memcpy(out, in, size);
+        }
+    }
+}
+
+} // namespace
+
+OrientedWriter::OrientedWriter(Orientation orientation)
+    : m_orientation{orientation}
+    , m_destination{nullptr}
+    , m_stride{0}
+    , m_width{0}
+    , m_height{0}
+    , m_pixelSize{0}
+    , m_rowSize{0}
+    , m_band{} {}
+
+Orientation OrientedWriter::orientation() const {
+    return m_orientation;
+}
+
+void OrientedWriter::begin(unsigned char* destination, size_t stride, uint32_t width, uint32_t height, size_t pixelSize) {
+    m_destination = destination;
+    m_stride = stride;
+    m_width = width;
+    m_height = height;
+    m_pixelSize = pixelSize;
+    m_rowSize = pixelSize * static_cast<size_t>(width);
+    if (isTransposing(m_orientation)) {
+        m_band.resize(BAND_ROWS * m_rowSize);
+    }
+}
+
+unsigned char* OrientedWriter::rowTarget(uint32_t row) {
+    if (isTransposing(m_orientation)) {
+        return m_band.data() + (row % BAND_ROWS) * m_rowSize;
+    }
+    // mirrored rows are reversed in place by `writeRow`
+    return destinationRow(row);
+}
+
+void OrientedWriter::writeRow(uint32_t row, const unsigned char* pixels) {
+    unsigned char* target = rowTarget(row);
+    if (isTransposing(m_orientation)) {
+        if (pixels != target) {
+            std::memcpy(target, pixels, m_rowSize);
+        }
+        const uint32_t bandRow = row % BAND_ROWS;
+        if (bandRow == BAND_ROWS - 1 || row == m_height - 1) {
+            transposeBand(row - bandRow, bandRow + 1);
+        }
+        return;
+    }
+
+    const bool mirrored = (m_orientation == Orientation::TopRight || m_orientation == Orientation::BottomRight);
+    if (!mirrored) {
+        if (pixels != target) {
+            std::memcpy(target, pixels, m_rowSize);
+        }
+        return;
+    }
+    if (m_width == 0) {
+        return;
+    }
+    if (pixels == target) {
+        switch (m_pixelSize) {
+        case 4: reversePixels<4>(target, m_width, m_pixelSize); break;
+        case 8: reversePixels<8>(target, m_width, m_pixelSize); break;
+        case 16: reversePixels<16>(target, m_width, m_pixelSize); break;
+        default: reversePixels<0>(target, m_width, m_pixelSize); break;
+        }
+    }
+    else {
+        switch (m_pixelSize) {
+        case 4: copyReversedPixels<4>(target, pixels, m_width, m_pixelSize); break;
+        case 8: copyReversedPixels<8>(target, pixels, m_width, m_pixelSize); break;
+        case 16: copyReversedPixels<16>(target, pixels, m_width, m_pixelSize); break;
+        default: copyReversedPixels<0>(target, pixels, m_width, m_pixelSize); break;
+        }
+    }
+}
+
+bool OrientedWriter::acceptsConcurrentRows() const {
+    // bands are gathered in order
+    return !isTransposing(m_orientation);
+}
+
+unsigned char* OrientedWriter::destinationRow(uint32_t row) const {
+    const bool flipped = (m_orientation == Orientation::BottomRight || m_orientation == Orientation::BottomLeft);
+    return m_destination + static_cast<size_t>(flipped ? m_height - 1 - row : row) * m_stride;
+}
+
+void OrientedWriter::transposeBand(uint32_t firstRow, uint32_t rowsCount) {
+    // stored row y lands in column y of the upright image, or in column `height - 1 - y` for right-top orientations
+    const bool reverseRows = (m_orientation == Orientation::RightTop || m_orientation == Orientation::RightBottom);
+    const bool reverseColumns = (m_orientation == Orientation::RightBottom || m_orientation == Orientation::LeftBottom);
+    const uint32_t firstColumn = reverseRows ? m_height - firstRow - rowsCount : firstRow;
+    unsigned char* destination = m_destination + firstColumn * m_pixelSize;
+
+    switch (m_pixelSize) {
+    case 4:
+        transposePixels<4>(m_band.data(), m_rowSize, rowsCount, m_width, destination, m_stride, m_pixelSize, reverseRows, reverseColumns);
+        break;
+    case 8:
+        transposePixels<8>(m_band.data(), m_rowSize, rowsCount, m_width, destination, m_stride, m_pixelSize, reverseRows, reverseColumns);
+        break;
+    case 16:
+        transposePixels<16>(m_band.data(), m_rowSize, rowsCount, m_width, destination, m_stride, m_pixelSize, reverseRows, reverseColumns);
+        break;
+    default:
+        transposePixels<0>(m_band.data(), m_rowSize, rowsCount, m_width, destination, m_stride, m_pixelSize, reverseRows, reverseColumns);
+        break;
+    }
+}
+
+} // namespace png_decoder::orientation
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "misc/orientation.h"
+
+
+namespace png_decoder::orientation {
+
+/*
+* Writes rows of the stored image straight to their places in the upright image, fusing the orientation
+* transform into the output instead of a separate pass over the decoded image.
+*
+* Flips and the 180 degrees rotation place every row right away (reversing it in place if mirrored).
+* Transposing orientations gather bands of BAND_ROWS rows, then copy every column of the band
+* as a contiguous run of BAND_ROWS pixels, so both the band and the destination are walked cache line by cache line.
+* Rows must therefore come in top to bottom order unless `acceptsConcurrentRows` is true.
+*/
+class OrientedWriter {
+public:
+    static constexpr uint32_t BAND_ROWS = 16;
+
+    explicit OrientedWriter(Orientation orientation);
+
+    Orientation orientation() const;
+
+    /* `destination` holds the upright image, rows `stride` bytes apart; `width` and `height` are of the stored image */
+    void begin(unsigned char* destination, size_t stride, uint32_t width, uint32_t height, size_t pixelSize);
+
+    /* memory to build the row in, passing it back to `writeRow` avoids a copy */
+    unsigned char* rowTarget(uint32_t row);
+    void writeRow(uint32_t row, const unsigned char* pixels);
+
+    /* whether rows may be written in any order and from several threads at once */
+    bool acceptsConcurrentRows() const;
+
+private:
+    unsigned char* destinationRow(uint32_t row) const;
+    void transposeBand(uint32_t firstRow, uint32_t rowsCount);
+
+private:
+    Orientation m_orientation;
+    unsigned char* m_destination;
+    size_t m_stride;
+    uint32_t m_width;
+    uint32_t m_height;
+    size_t m_pixelSize;
+    size_t m_rowSize;
+    // rows of the current band of a transposing orientation
+    std::vector<unsigned char> m_band;
+};
+
+} // namespace png_decoder::orientation
@@ -1,15 +1,22 @@
 #include <string_view>
-#include <cassert>
 #include <iostream>
 #include <istream>
 #include <fstream>
 #include <cstring>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <zlib.h>
 
 #include "png_decoder.h"
 #include "exceptions/exceptions.h"
 #include "scanline-reader/scanline_reader.h"
 #include "utils/utils.h"
+#include "utils/memory_stream.h"
 #include "inflate/inflate.h"
+#include "interlace/adam7.h"
+#include "defilter/defilter.h"
+#include "orientation/exif.h"
 
 // misc
 #include "misc/crc.h"
@@ -19,169 +26,1136 @@
 
 namespace png_decoder {
 
-PNGDecoder::PNGDecoder(std::istream& stream) {
+namespace {
+
+// crc of a chunk covers its type and data, but not its length
+crc::CRC startChunkCRC(uint32_t chunkType) {
+    const unsigned char typeBytes[] = {
+        static_cast<unsigned char>(chunkType >> 24),
+        static_cast<unsigned char>(chunkType >> 16),
+        static_cast<unsigned char>(chunkType >> 8),
+        static_cast<unsigned char>(chunkType),
+    };
+
+    crc::CRC crc;
+    crc.process_bytes(typeBytes, sizeof(typeBytes));
+    return crc;
+}
+
+/*
+* Appends chunk data to `dest` in steps growing with the bytes already read, so a corrupt length of a truncated
+* stream allocates at most about twice the stream size instead of the 2 GiB the length may claim.
+*/
+bool appendChunkData(std::istream& stream, uint32_t length, std::vector<unsigned char>& dest) {
+    static constexpr size_t MIN_READ_STEP = 64 * 1024;
+
+    for (uint32_t remaining = length; remaining > 0;) {
+        const size_t size = std::min<size_t>(remaining, std::max(MIN_READ_STEP, dest.size()));
+        const size_t offset = dest.size();
+        dest.resize(offset + size);
+        if (!stream.read(reinterpret_cast<char*>(dest.data() + offset), size)) {
+            return false;
+        }
+        remaining -= size;
+    }
+    return true;
+}
+
+} // namespace
+
+
+PNGDecoder::PNGDecoder(std::istream& stream, DecodeOptions options) : PNGDecoder(std::move(options)) {
+    parse(stream).value();
+}
+
+PNGDecoder::PNGDecoder(DecodeOptions options)
+    : m_options{std::move(options)}, m_frameData{nullptr}, m_orientation{Orientation::TopLeft} {}
+
+Expected<PNGDecoder> PNGDecoder::tryCreate(std::istream& stream, DecodeOptions options) {
+    PNGDecoder decoder(std::move(options));
+    PNG_DECODER_TRY(decoder.parse(stream));
+    return decoder;
+}
+
+Expected<void> PNGDecoder::parse(std::istream& stream) {
     // reading signature
     uint64_t signature;
 
-    utils::readFromBigEndianAndConvertToHostEndianess(
-        stream, &signature, sizeof(signature), PNG_DECODER_ERROR_MESSAGE("Cannot read signature"));
+    if (!utils::readFromBigEndianAndConvertToHostEndianess(stream, &signature, sizeof(signature))) {
+        return DecodeError{DecodeErrorCode::TruncatedStream};
+    }
+
+    PNG_DECODER_TRY(validateSignature(signature));
 
-    validateSignature(signature);
+    // buffer for data of chunks which cannot be viewed in place, reused by all of them
+    std::vector<unsigned char> chunkBuffer;
 
     // reading IHDR
-    Chunk ihdrChunk = readChunk(stream);
-    storeIHDR(ihdrChunk);
+    const Expected<ChunkHeader> ihdrHeader = readChunkHeader(stream);
+    PNG_DECODER_TRY(ihdrHeader);
+    PNG_DECODER_TRY(validateIHDR(ihdrHeader->type));
+    uint64_t chunksCount = 1;
+    PNG_DECODER_TRY(validateChunkLimits(*ihdrHeader, chunksCount));
+    const Expected<ChunkView> ihdrChunk = readChunk(stream, *ihdrHeader, chunkBuffer);
+    PNG_DECODER_TRY(ihdrChunk);
+    PNG_DECODER_TRY(storeIHDR(*ihdrChunk));
+    // before any chunk of the image data is read
+    PNG_DECODER_TRY(validateImageLimits());
+
+    // positions in the stream are needed to resolve IDAT offsets stored in iDOT chunk
+    std::vector<std::pair<std::streamoff, size_t>> idatPositions;
+    std::streamoff idotPosition = -1;
+    std::vector<unsigned char> idotData;
+    // fcTL and fdAT chunks share a single sequence
+    uint32_t sequenceNumber = 0;
+    // fdAT data is kept in memory like IDAT data
+    uint64_t framesDataSize = 0;
+    // IDAT data is hashed chunk by chunk while it is still in cache
+    std::optional<utils::XXHash64> dataHash;
+    if (m_options.hashContent) {
+        dataHash.emplace();
+    }
 
     // reading other chunks
     bool stop = false;
     while (!stop) {
-        Chunk chunk = readChunk(stream);
+        const std::streamoff position = stream.tellg();
+        const Expected<ChunkHeader> expectedHeader = readChunkHeader(stream);
+        PNG_DECODER_TRY(expectedHeader);
+        const ChunkHeader& header = *expectedHeader;
+        PNG_DECODER_TRY(validateChunkLimits(header, ++chunksCount));
+
+        if (isIDAT(header.type)) {
+            PNG_DECODER_TRY(validateMemory(header.length, 1));
+            idatPositions.emplace_back(position, m_data.size());
+            PNG_DECODER_TRY(storeIDAT(stream, header, dataHash));
+            continue;
+        }
 
-        if (isIEND(chunk.type)) {
+        // known chunks of other types are read whole, the rest are skipped
+        const bool known = isIEND(header.type) || isPLTE(header.type) || isZSEG(header.type) ||
+                           isGAMA(header.type) || isSRGB(header.type) || isCHRM(header.type) ||
+                           isACTL(header.type) || isFCTL(header.type) || isFDAT(header.type) ||
+                           isIDOT(header.type) || isEXIF(header.type) || isTRNS(header.type) ||
+                           m_options.chunkHandlers.count(header.type) > 0;
+        if (!known) {
+            // TODO: return an error for unsupported critical chunk types
+            PNG_DECODER_TRY(skipChunk(stream, header, m_options.verifySkippedChunksCRC));
+            continue;
+        }
+
+        if (isFDAT(header.type)) {
+            framesDataSize += header.length;
+            PNG_DECODER_TRY(validateMemory(framesDataSize, 1));
+        }
+
+        const Expected<ChunkView> expectedChunk = readChunk(stream, header, chunkBuffer);
+        PNG_DECODER_TRY(expectedChunk);
+        const ChunkView& chunk = *expectedChunk;
+
+        if (isIEND(header.type)) {
             if (stream.peek() != std::ifstream::traits_type::eof()) {
-                throw exceptions::InvalidIENDChunkException();
+                return DecodeError{DecodeErrorCode::InvalidIEND, header.type};
             }
             stop = true;
         }
-        else if (isIDAT(chunk.type)) {
-            storeIDAT(chunk);
+        else if (isPLTE(header.type)) {
+            PNG_DECODER_TRY(storePLTE(chunk));
+        }
+        else if (isZSEG(header.type)) {
+            storeZSEG(chunk);
         }
-        else if (isPLTE(chunk.type)) {
-            storePLTE(chunk);
+        else if (isGAMA(header.type)) {
+            storeGAMA(chunk);
+        }
+        else if (isSRGB(header.type)) {
+            storeSRGB(chunk);
+        }
+        else if (isCHRM(header.type)) {
+            storeCHRM(chunk);
+        }
+        else if (isACTL(header.type)) {
+            storeACTL(chunk);
+        }
+        else if (isFCTL(header.type)) {
+            storeFCTL(chunk, sequenceNumber);
+        }
+        else if (isFDAT(header.type)) {
+            storeFDAT(chunk, sequenceNumber);
+        }
+        else if (isIDOT(header.type)) {
+            // iDOT precedes the IDAT chunks it refers to
+            idotPosition = position;
+            idotData.assign(chunk.data, chunk.data + chunk.length);
+        }
+        else if (isTRNS(header.type)) {
+            storeTRNS(chunk);
+        }
+        else if (isEXIF(header.type)) {
+            storeEXIF(chunk);
+            if (m_options.chunkHandlers.count(header.type) > 0) {
+                m_options.chunkHandlers.at(header.type)(chunk);
+            }
         }
         else {
-            // TODO: throw exceptions::CriticalChunkTypeChunkException if critical chunk type
-            // unsupported chunk type
-            // throw exceptions::CriticalChunkTypeChunkException(
-            //     PNG_DECODER_ERROR_MESSAGE("Unsupported critical chunk with type " + utils::stringifyChunkType(chunk.type) + std::to_string(chunk.type)));
+            m_options.chunkHandlers.at(header.type)(chunk);
         }
     }
 
-    inflate::Inflate inflateWrapper{};
-    // replacing with inflated data
-    m_data = inflateWrapper.doInflate(m_data);
+    if (m_segments.empty() && idotPosition != -1) {
+        const ChunkView idotChunk{IDOT_CHUNK_TYPE, idotData.data(), static_cast<uint32_t>(idotData.size())};
+        storeIDOT(idotChunk, idotPosition, idatPositions);
+    }
+    validateSegments();
+
+    if (m_ihdr.colorType == PIXEL_PALETTE_INDEX_COLOR_TYPE && m_plte.palette.empty()) {
+        return DecodeError{DecodeErrorCode::MissingPLTE, PLTE_CHUNK_TYPE};
+    }
+    PNG_DECODER_TRY(validateDataSize());
+    validateAnimation();
+
+    if (dataHash.has_value()) {
+        m_contentHash = contentHash(dataHash->digest());
+    }
+    m_orientation = (m_options.useExifOrientation && m_exifOrientation.has_value()) ? *m_exifOrientation : m_options.orientation;
+
+    // reducers need straight RGBA rows, which the transform converts into other 8-bit layouts too
+    const PixelFormat& format = m_options.pixelFormat;
+    const bool straightRGBA = format.channelOrder == ChannelOrder::RGBA && format.alphaMode == AlphaMode::Straight;
+    if (isPaletteIndex(format)) {
+        // indices are not colors to reduce
+        m_options.reducers.clear();
+    }
+    else if (!isEncoded8Bit(format) || (!m_options.reducers.empty() && !straightRGBA)) {
+        m_colorTransform.emplace(m_colorInfo, format);
+    }
+    return {};
 }
 
+PNGDecoder::PNGDecoder(const PNGDecoder& image, const AnimationFrame& frame, size_t threadsCount)
+    : m_options{image.m_options}
+    , m_ihdr{image.m_ihdr}
+    , m_plte{image.m_plte}
+    , m_data{}
+    , m_frameData{frame.defaultImage ? &image.imageData() : &frame.data}
+    , m_segments{frame.defaultImage ? image.m_segments : std::vector<ImageSegment>{}}
+    , m_colorInfo{image.m_colorInfo}
+    , m_colorTransform{image.m_colorTransform}
+    , m_animationControl{}
+    , m_frames{}
+    , m_contentHash{}
+    , m_exifOrientation{}
+    , m_orientation{Orientation::TopLeft}
+    {
+        m_ihdr.width = frame.control.width;
+        m_ihdr.height = frame.control.height;
+        m_options.reducers.clear();
+        m_options.threadsCount = threadsCount;
+    }
+
 Image PNGDecoder::createImage() const {
-    Image image(m_ihdr.height, m_ihdr.width);
+    return tryCreateImage().value();
+}
 
+void PNGDecoder::decode(sink::RowSink& sink) const {
+    tryDecode(sink).value();
+}
+
+void PNGDecoder::decode(const image_view::ImageView& view) const {
+    tryDecode(view).value();
+}
+
+Expected<Image> PNGDecoder::tryCreateImage() const {
+    return tryCreateImage(m_orientation);
+}
+
+Expected<void> PNGDecoder::tryDecode(sink::RowSink& sink) const {
     if (m_ihdr.interlaceMethod == NULL_INTERLACING_METHOD) {
-        fillImageNullInterlace(image);
+        if (m_options.threadsCount > 1 && m_segments.size() > 1) {
+            PNG_DECODER_TRY(validateMemory(inflatedSize(), 1));
+            thread_pool::ThreadPool pool(std::min(m_options.threadsCount, m_segments.size()));
+            std::vector<unsigned char> data;
+            if (inflateSegments(pool, data)) {
+                return decodeSegments(sink, pool, data);
+            }
+        }
+        else if (m_options.threadsCount > 1 && convertsInBands(sink)) {
+            thread_pool::ThreadPool pool(m_options.threadsCount);
+            Expected<std::vector<unsigned char>> data = inflateImage();
+            PNG_DECODER_TRY(data);
+            return decodeBands(sink, pool, *data);
+        }
+        return decodeNullInterlace(sink);
     }
     else if (m_ihdr.interlaceMethod == ADAM7_INTERLACING_METHOD) {
-        fillImageAdam7Interlace(image);
+        // last pass fills every odd row, so no row is complete before the whole stream is inflated
+        const Expected<std::vector<unsigned char>> data = inflateImage();
+        PNG_DECODER_TRY(data);
+        return decodeAdam7Interlace(sink, *data);
     }
-    else {
-        throw exceptions::DecodingException(
-            PNG_DECODER_ERROR_MESSAGE("Invalid interlace method: " + std::to_string(m_ihdr.interlaceMethod)));
+    return DecodeError{DecodeErrorCode::InvalidInterlaceMethod, IHDR_CHUNK_TYPE, {m_ihdr.interlaceMethod}};
+}
+
+sink::IndexedImage PNGDecoder::createIndexedImage(sink::IndexLayout layout) const {
+    return tryCreateIndexedImage(layout).value();
+}
+
+Expected<sink::IndexedImage> PNGDecoder::tryCreateIndexedImage(sink::IndexLayout layout) const {
+    if (m_ihdr.colorType != PIXEL_PALETTE_INDEX_COLOR_TYPE) {
+        return DecodeError{DecodeErrorCode::PaletteIndexOfNonPaletteImage, IHDR_CHUNK_TYPE, {m_ihdr.colorType}};
     }
 
+    PNG_DECODER_TRY(validateMemory(m_ihdr.height,
+                                   (layout == sink::IndexLayout::Bytes) ? m_ihdr.width : scanlineSize(m_ihdr)));
+
+    sink::IndexedImage image;
+    image.palette = m_plte.palette;
+    image.alpha = m_plte.alpha;
+    sink::IndexSink sink(image, layout, m_ihdr.bitDepth, m_orientation);
+    if (isPaletteIndex(m_options.pixelFormat)) {
+        PNG_DECODER_TRY(tryDecode(sink));
+        return image;
+    }
+
+    // a copy decoding indices: the image data is compressed, so copying it costs little next to inflating it
+    PNGDecoder indexed(*this);
+    indexed.m_options.pixelFormat.sampleType = SampleType::PaletteIndex;
+    indexed.m_options.reducers.clear();
+    indexed.m_colorTransform.reset();
+    PNG_DECODER_TRY(indexed.tryDecode(sink));
     return image;
 }
 
+Expected<void> PNGDecoder::tryDecode(const image_view::ImageView& view) const {
+    sink::BufferSink sink(view, m_orientation);
+    return tryDecode(sink);
+}
+
 // methods
-void PNGDecoder::fillImageAdam7Interlace(Image& image) const {
-    // define the starting column, starting row, column increment, and row increment for each pass
-    uint32_t starting_col[]  = {0, 4, 0, 2, 0, 1, 0};
-    uint32_t starting_row[]  = {0, 0, 4, 0, 2, 0, 1};
-    uint32_t col_increment[] = {8, 8, 4, 4, 2, 2, 1};
-    uint32_t row_increment[] = {8, 8, 8, 4, 4, 2, 2};
+/*
+* Pass scanlines are defiltered in place in the inflated stream, every pass keeping its own previous scanline.
+* Rows are assembled in image order from the current rows of the passes present in them (see `interlace/adam7.h`),
+* so neither the passes nor the whole image are ever copied, and rows reach the sink as soon as they are complete.
+*/
+Expected<void> PNGDecoder::decodeAdam7Interlace(sink::RowSink& sink, const std::vector<unsigned char>& data) const {
+    using interlace::ADAM7_PASSES;
+    using interlace::ADAM7_PASSES_COUNT;
+
+    std::vector<scanline_reader::ScanlineReader> readers;
+    readers.reserve(ADAM7_PASSES_COUNT);
+    std::array<uint32_t, ADAM7_PASSES_COUNT> widths{};
+    std::array<size_t, ADAM7_PASSES_COUNT> rowSizes{};
+    std::array<const unsigned char*, ADAM7_PASSES_COUNT> nextRows{};
 
-    // calculate the size and position of each pass
-    const size_t PASSES_COUNT = 7;
+    size_t offset = 0;
+    for (size_t i = 0; i < ADAM7_PASSES_COUNT; ++i) {
+        widths[i] = interlace::passWidth(ADAM7_PASSES[i], m_ihdr.width);
+        const uint32_t height = interlace::passHeight(ADAM7_PASSES[i], m_ihdr.height);
+        readers.emplace_back(widths[i], height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, data);
+
+        /*
+        * See: http://www.libpng.org/pub/png/spec/1.2/PNG-DataRep.html#DR.Image-layout
+        * If the image contains fewer than five columns or fewer than five rows,
+        * some passes will be entirely empty, without filter method bytes either.
+        */
+        rowSizes[i] = (widths[i] == 0) ? 0 : 1 + static_cast<size_t>(readers[i].getScanlineSize());
+        const size_t length = rowSizes[i] * height;
+        if (length > data.size() - offset) {
+            return DecodeError{DecodeErrorCode::TruncatedAdam7Pass, IDAT_CHUNK_TYPE, {data.size(), i + 1}};
+        }
+        nextRows[i] = data.data() + offset;
+        offset += length;
+    }
 
-    uint32_t pass_width[PASSES_COUNT] = {0};
-    uint32_t pass_height[PASSES_COUNT] = {0};
+    // pass rows are converted before interleaving: into the format of the sink, the color transform input or RGB
+    const bool packed = sink.acceptsPackedRows();
+    const bool transformed = packed && m_colorTransform.has_value();
+    const PixelFormat passFormat = transformed ? PixelFormat{} : m_options.pixelFormat;
+    const size_t pixelSize = !packed ? sizeof(RGB) : (transformed ? PACKED_PIXEL_SIZE : packedPixelSize(passFormat));
 
-    for (size_t i = 0; i < PASSES_COUNT; i++) {
-        pass_width[i]  = (m_ihdr.width  + col_increment[i] - starting_col[i] - 1) / col_increment[i];
-        pass_height[i] = (m_ihdr.height + row_increment[i] - starting_row[i] - 1) / row_increment[i];
+    std::array<std::vector<unsigned char>, ADAM7_PASSES_COUNT> passRows;
+    for (size_t i = 0; i < ADAM7_PASSES_COUNT; ++i) {
+        passRows[i].resize(widths[i] * pixelSize);
     }
+    std::vector<RGB> passPixels;
+    // columns 0 mod 4 of row 0 of a block, and even columns of rows 0 and 4
+    std::vector<unsigned char> quarterColumns(widths[0] * pixelSize + widths[1] * pixelSize);
+    std::vector<unsigned char> evenColumns((m_ihdr.width + 1) / 2 * pixelSize);
 
-    std::vector<std::vector<unsigned char>> passes(PASSES_COUNT);
+    auto readPassRow = [&](size_t pass, unsigned char* out) -> Expected<void> {
+        if (widths[pass] == 0) {
+            return {};
+        }
+        if (!scanline_reader::ScanlineReader::isFilterMethodValid(*nextRows[pass])) {
+            return DecodeError{DecodeErrorCode::InvalidFilterType, IDAT_CHUNK_TYPE, {*nextRows[pass], readers[pass].getRow()}};
+        }
+        if (packed) {
+            readers[pass].readPackedFrom(nextRows[pass], passFormat, out);
+        }
+        else {
+            readers[pass].readFrom(nextRows[pass], passPixels);
+            std::memcpy(out, passPixels.data(), passPixels.size() * sizeof(RGB));
+        }
+        nextRows[pass] += rowSizes[pass];
+        return {};
+    };
 
-    uint32_t offset = 0;
-    for (size_t i = 0; i < PASSES_COUNT; ++i) {
-        uint32_t width = pass_width[i];
-        uint32_t height = pass_height[i];
+    auto interleave = [&](const unsigned char* even, size_t evenCount, size_t oddPass, unsigned char* out) {
+        interlace::interleavePixels(even, evenCount, passRows[oddPass].data(), widths[oddPass], pixelSize, out);
+    };
 
-        // creating reader to determine scanline size
-        scanline_reader::ScanlineReader reader(width, height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, passes[i]);
-        uint32_t length = (1 + reader.getScanlineSize()) * height;
-        passes[i].resize(length);
+    PNG_DECODER_TRY(beginSink(sink, m_ihdr.height));
+    RowBuffers buffers;
+    for (uint32_t row = 0; row < m_ihdr.height; ++row) {
+        unsigned char* out = nullptr;
+        if (!packed) {
+            buffers.pixels.resize(m_ihdr.width);
+            out = reinterpret_cast<unsigned char*>(buffers.pixels.data());
+        }
+        else if (transformed) {
+            buffers.rgba.resize(PACKED_PIXEL_SIZE * m_ihdr.width);
+            out = buffers.rgba.data();
+        }
+        else {
+            out = packedRowTarget(sink, row, buffers);
+        }
 
-        // reading reduced image
-        std::memcpy(passes[i].data(), m_data.data() + offset, length);
-        offset += length;
+        switch (row % interlace::ADAM7_BLOCK_SIZE) {
+        case 0:
+            PNG_DECODER_TRY(readPassRow(0, passRows[0].data()));
+            PNG_DECODER_TRY(readPassRow(1, passRows[1].data()));
+            PNG_DECODER_TRY(readPassRow(3, passRows[3].data()));
+            interleave(passRows[0].data(), widths[0], 1, quarterColumns.data());
+            interleave(quarterColumns.data(), widths[0] + widths[1], 3, evenColumns.data());
+            break;
+        case 4:
+            PNG_DECODER_TRY(readPassRow(2, passRows[2].data()));
+            PNG_DECODER_TRY(readPassRow(3, passRows[3].data()));
+            interleave(passRows[2].data(), widths[2], 3, evenColumns.data());
+            break;
+        case 2:
+        case 6:
+            PNG_DECODER_TRY(readPassRow(4, evenColumns.data()));
+            break;
+        default:
+            // the only pass of odd rows is as wide as the image
+            PNG_DECODER_TRY(readPassRow(6, out));
+            break;
+        }
+
+        if (row % 2 == 0) {
+            PNG_DECODER_TRY(readPassRow(5, passRows[5].data()));
+            interleave(evenColumns.data(), (m_ihdr.width + 1) / 2, 5, out);
+        }
+
+        if (!packed) {
+            reduceRow(row, buffers.pixels, buffers);
+            sink.write(row, buffers.pixels);
+        }
+        else if (transformed) {
+            reduceRow(row, buffers.rgba.data());
+            unsigned char* target = packedRowTarget(sink, row, buffers);
+            m_colorTransform->apply(buffers.rgba.data(), m_ihdr.width, target);
+            sink.writePacked(row, target);
+        }
+        else {
+            reduceRow(row, out);
+            sink.writePacked(row, out);
+        }
     }
+    sink.end();
+    return {};
+}
 
-    for (int i = 0; i < 7; ++i) {
-        uint32_t width = pass_width[i];
-        uint32_t height = pass_height[i];
 
-        /*
-        * See: http://www.libpng.org/pub/png/spec/1.2/PNG-DataRep.html#DR.Image-layout
-        * If the image contains fewer than five columns or fewer than five rows,
-        * some passes will be entirely empty.
-        */
-        if (width == 0 || height == 0) {
-            continue;
+Expected<void> PNGDecoder::decodeNullInterlace(sink::RowSink& sink) const {
+    // scanlines are fed from the inflate stream, so the reader never accesses its buffer
+    const std::vector<unsigned char> unused{};
+    scanline_reader::ScanlineReader reader(m_ihdr.width, m_ihdr.height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, unused);
+
+    scanline_reader::ScanlineAssembler assembler(reader.getScanlineSize());
+    RowBuffers buffers;
+
+    PNG_DECODER_TRY(beginSink(sink, m_ihdr.height));
+
+    // the rest of the stream is still inflated after the last row, so that its errors are not missed
+    Expected<void> status;
+    uint64_t inflated = 0;
+    inflate::Inflate inflateWrapper{};
+    PNG_DECODER_TRY(inflateWrapper.tryInflate(imageData(), [&](const unsigned char* buffer, size_t size) {
+        inflated += size;
+        status = validateInflatedBytes(inflated);
+        if (!status || !reader.hasNext()) {
+            return status.hasValue();
+        }
+        assembler.feed(buffer, size, [&](const unsigned char* bytes) {
+            const uint32_t row = reader.getRow();
+            status = writeRow(sink, reader, row, bytes, buffers);
+            return status.hasValue() && reader.hasNext();
+        });
+        return status.hasValue();
+    }));
+    PNG_DECODER_TRY(status);
+
+    PNG_DECODER_TRY(validateRowsRead(reader));
+    sink.end();
+    return {};
+}
+
+
+/*
+* Inflates every segment on its own thread directly into its place in `data`.
+* Returns false if the segments turn out not to be independent deflate streams,
+* so that the caller falls back to serial decoding (the index chunk is ancillary and may lie).
+*/
+bool PNGDecoder::inflateSegments(thread_pool::ThreadPool& pool, std::vector<unsigned char>& data) const {
+    const std::vector<unsigned char> unused{};
+    scanline_reader::ScanlineReader reader(m_ihdr.width, m_ihdr.height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, unused);
+    const size_t rowSize = 1 + reader.getScanlineSize();
+
+    data.resize(rowSize * m_ihdr.height);
+
+    std::vector<inflate::Inflate::SegmentResult> results(m_segments.size());
+    std::vector<uLong> checksums(m_segments.size());
+    // not std::vector<bool>: its elements are written concurrently
+    std::vector<unsigned char> failed(m_segments.size(), false);
+
+    thread_pool::runParallel(pool, m_segments.size(), [&](size_t i) {
+        const ImageSegment& segment = m_segments[i];
+        const size_t end = (i + 1 < m_segments.size()) ? m_segments[i + 1].dataOffset : imageData().size();
+        unsigned char* dest = data.data() + segment.firstRow * rowSize;
+        const size_t destSize = segment.rowsCount * rowSize;
+
+        inflate::Inflate inflateWrapper{};
+        const Expected<inflate::Inflate::SegmentResult> result = inflateWrapper.doInflateSegment(
+            imageData().data() + segment.dataOffset, end - segment.dataOffset, dest, destSize, i == 0);
+        if (!result) {
+            failed[i] = true;
+            return;
+        }
+        results[i] = *result;
+        checksums[i] = adler32(adler32(0L, Z_NULL, 0), dest, results[i].inflated);
+    });
+
+    for (size_t i = 0; i < m_segments.size(); ++i) {
+        if (failed[i] || results[i].inflated != m_segments[i].rowsCount * rowSize) {
+            return false;
+        }
+    }
+
+    // zlib stream trailer follows the final block, which must be in the last segment
+    const ImageSegment& last = m_segments.back();
+    const size_t trailerOffset = last.dataOffset + results.back().consumed;
+    if (!results.back().streamEnd || trailerOffset + sizeof(uint32_t) > imageData().size()) {
+        return false;
+    }
+
+    uLong checksum = checksums[0];
+    for (size_t i = 1; i < m_segments.size(); ++i) {
+        checksum = adler32_combine(checksum, checksums[i], m_segments[i].rowsCount * rowSize);
+    }
+    return checksum == utils::readBigEndianUInt32(imageData().data() + trailerOffset);
+}
+
+
+Expected<void> PNGDecoder::decodeSegments(sink::RowSink& sink, thread_pool::ThreadPool& pool, std::vector<unsigned char>& data) const {
+    const std::vector<unsigned char> unused{};
+    scanline_reader::ScanlineReader reader(m_ihdr.width, m_ihdr.height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, data);
+    const size_t rowSize = 1 + reader.getScanlineSize();
+
+    // a segment can be defiltered on its own only if its first scanline does not refer to the previous one
+    const bool concurrent = sink.acceptsConcurrentRows() && m_options.reducers.empty();
+    bool independent = concurrent;
+    for (const auto& segment : m_segments) {
+        independent = independent && !defilter::Defilter::dependsOnPreviousScanline(data[segment.firstRow * rowSize]);
+    }
+    if (concurrent && !independent) {
+        return decodeBands(sink, pool, data);
+    }
+
+    PNG_DECODER_TRY(beginSink(sink, m_ihdr.height));
+
+    if (independent) {
+        std::vector<Expected<void>> statuses(m_segments.size());
+        thread_pool::runParallel(pool, m_segments.size(), [&](size_t i) {
+            const ImageSegment& segment = m_segments[i];
+            scanline_reader::ScanlineReader segmentReader(
+                m_ihdr.width, segment.rowsCount, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, unused);
+            RowBuffers buffers;
+
+            for (uint32_t row = segment.firstRow; row < segment.firstRow + segment.rowsCount && statuses[i]; ++row) {
+                statuses[i] = writeRow(sink, segmentReader, row, &data[row * rowSize], buffers);
+            }
+        });
+        for (const auto& status : statuses) {
+            PNG_DECODER_TRY(status);
+        }
+    }
+    else {
+        RowBuffers buffers;
+        for (uint32_t row = 0; reader.hasNext(); ++row) {
+            PNG_DECODER_TRY(writeRow(sink, reader, row, &data[row * rowSize], buffers));
+        }
+    }
+
+    sink.end();
+    return {};
+}
+
+
+bool PNGDecoder::convertsInBands(const sink::RowSink& sink) const {
+    return sink.acceptsConcurrentRows() && m_options.reducers.empty() &&
+           static_cast<uint64_t>(m_ihdr.width) * m_ihdr.height >= MIN_BAND_CONVERSION_PIXELS;
+}
+
+
+/*
+* Every scanline refers to the previous one, so defiltering stays serial, but it is a small part of decoding
+* next to the conversion of pixels (palette lookup, sub-byte expansion, packing, color transform).
+* Defiltered scanlines are left in `data` with filter method None, which lets bands of rows be converted
+* by readers of their own. The whole inflated image is kept in memory for that.
+*/
+Expected<void> PNGDecoder::decodeBands(sink::RowSink& sink, thread_pool::ThreadPool& pool, std::vector<unsigned char>& data) const {
+    const std::vector<unsigned char> unused{};
+    scanline_reader::ScanlineReader reader(m_ihdr.width, m_ihdr.height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, unused);
+    const size_t rowSize = 1 + reader.getScanlineSize();
+
+    if (data.size() / rowSize < m_ihdr.height) {
+        return DecodeError{DecodeErrorCode::TruncatedImageData, IDAT_CHUNK_TYPE, {data.size() / rowSize, m_ihdr.height}};
+    }
+    for (uint32_t row = 0; row < m_ihdr.height; ++row) {
+        unsigned char* bytes = &data[row * rowSize];
+        if (!scanline_reader::ScanlineReader::isFilterMethodValid(bytes[0])) {
+            return DecodeError{DecodeErrorCode::InvalidFilterType, IDAT_CHUNK_TYPE, {bytes[0], row}};
+        }
+        reader.defilterInPlace(bytes);
+    }
+
+    PNG_DECODER_TRY(beginSink(sink, m_ihdr.height));
+
+    const size_t bandsCount = std::min<size_t>(m_ihdr.height, pool.threadsCount() * BANDS_PER_THREAD);
+    const uint32_t bandRows = (m_ihdr.height + bandsCount - 1) / bandsCount;
+    std::vector<Expected<void>> statuses(bandsCount);
+    thread_pool::runParallel(pool, bandsCount, [&](size_t i) {
+        const uint32_t firstRow = i * bandRows;
+        const uint32_t lastRow = std::min<uint32_t>(firstRow + bandRows, m_ihdr.height);
+        if (firstRow >= lastRow) {
+            return;
+        }
+        scanline_reader::ScanlineReader bandReader(
+            m_ihdr.width, lastRow - firstRow, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, unused);
+        RowBuffers buffers;
+
+        for (uint32_t row = firstRow; row < lastRow && statuses[i]; ++row) {
+            statuses[i] = writeRow(sink, bandReader, row, &data[row * rowSize], buffers);
         }
+    });
+    for (const auto& status : statuses) {
+        PNG_DECODER_TRY(status);
+    }
+
+    sink.end();
+    return {};
+}
+
+
+row_index::RowIndex PNGDecoder::buildRowIndex(uint32_t rowsPerCheckpoint) const {
+    return tryBuildRowIndex(rowsPerCheckpoint).value();
+}
+
+
+Expected<row_index::RowIndex> PNGDecoder::tryBuildRowIndex(uint32_t rowsPerCheckpoint) const {
+    if (m_ihdr.interlaceMethod != NULL_INTERLACING_METHOD) {
+        return DecodeError{DecodeErrorCode::RowIndexOfInterlacedImage};
+    }
+    // the whole stream is inflated like on decoding, so the same limits apply
+    PNG_DECODER_TRY(validateImageLimits());
+
+    row_index::RowIndex index{};
+    index.width = m_ihdr.width;
+    index.height = m_ihdr.height;
+    index.bitDepth = m_ihdr.bitDepth;
+    index.colorType = m_ihdr.colorType;
+    index.dataSize = imageData().size();
+    index.dataCrc = crc32(crc32(0L, Z_NULL, 0), imageData().data(), imageData().size());
+    index.rowsPerCheckpoint = std::max<uint32_t>(1, rowsPerCheckpoint);
+
+    const std::vector<unsigned char> unused{};
+    scanline_reader::ScanlineReader reader(m_ihdr.width, m_ihdr.height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, unused);
+    scanline_reader::ScanlineAssembler assembler(reader.getScanlineSize());
+
+    Expected<void> status;
+    uint64_t inflated = 0;
+    // windows, row prefixes and previous scanlines of the checkpoints taken so far
+    uint64_t indexBytes = 0;
+    uint32_t nextCheckpointRow = 0;
+    inflate::Inflate inflateWrapper{};
+    PNG_DECODER_TRY(inflateWrapper.tryInflateIndexed(
+        imageData(),
+        [&](const unsigned char* buffer, size_t size) {
+            inflated += size;
+            status = validateInflatedBytes(inflated);
+            if (!status || !reader.hasNext()) {
+                return status.hasValue();
+            }
+            assembler.feed(buffer, size, [&](const unsigned char* bytes) {
+                if (!scanline_reader::ScanlineReader::isFilterMethodValid(bytes[0])) {
+                    status = DecodeError{DecodeErrorCode::InvalidFilterType, IDAT_CHUNK_TYPE, {bytes[0], reader.getRow()}};
+                    return false;
+                }
+                reader.defilterFrom(bytes);
+                return reader.hasNext();
+            });
+            return status.hasValue();
+        },
+        [&]() {
+            if (!reader.hasNext() || reader.getRow() < nextCheckpointRow) {
+                return true;
+            }
+
+            Expected<inflate::Inflate::AccessPoint> point = inflateWrapper.tryAccessPoint();
+            if (!point) {
+                status = point.error();
+                return false;
+            }
+
+            row_index::Checkpoint checkpoint{};
+            checkpoint.row = reader.getRow();
+            checkpoint.point = std::move(point.value());
+            checkpoint.rowPrefix = assembler.pending();
+            if (checkpoint.row > 0) {
+                checkpoint.previousScanline = reader.getPreviousScanline().data;
+            }
+
+            indexBytes += checkpoint.point.window.size() + checkpoint.rowPrefix.size() + checkpoint.previousScanline.size();
+            status = validateMemory(indexBytes, 1);
+            if (!status) {
+                return false;
+            }
+            index.checkpoints.push_back(std::move(checkpoint));
+            nextCheckpointRow = reader.getRow() + index.rowsPerCheckpoint;
+            return true;
+        }));
+    PNG_DECODER_TRY(status);
+
+    PNG_DECODER_TRY(validateRowsRead(reader));
+    return index;
+}
+
+
+bool PNGDecoder::isRowIndexValid(const row_index::RowIndex& index) const {
+    return index.width == m_ihdr.width &&
+           index.height == m_ihdr.height &&
+           index.bitDepth == m_ihdr.bitDepth &&
+           index.colorType == m_ihdr.colorType &&
+           index.dataSize == imageData().size() &&
+           index.dataCrc == crc32(crc32(0L, Z_NULL, 0), imageData().data(), imageData().size());
+}
+
+
+Image PNGDecoder::decodeRows(const row_index::RowIndex& index, uint32_t firstRow, uint32_t lastRow) const {
+    return tryDecodeRows(index, firstRow, lastRow).value();
+}
+
+
+void PNGDecoder::decodeRows(const row_index::RowIndex& index, uint32_t firstRow, uint32_t lastRow, sink::RowSink& sink) const {
+    tryDecodeRows(index, firstRow, lastRow, sink).value();
+}
+
+
+Expected<Image> PNGDecoder::tryDecodeRows(const row_index::RowIndex& index, uint32_t firstRow, uint32_t lastRow) const {
+    Image image;
+    sink::ImageSink sink(image);
+    PNG_DECODER_TRY(tryDecodeRows(index, firstRow, lastRow, sink));
+    return image;
+}
+
+
+Expected<void> PNGDecoder::tryDecodeRows(const row_index::RowIndex& index, uint32_t firstRow, uint32_t lastRow,
+                                         sink::RowSink& sink) const {
+    if (m_ihdr.interlaceMethod != NULL_INTERLACING_METHOD) {
+        return DecodeError{DecodeErrorCode::RowIndexOfInterlacedImage};
+    }
+    // checksum is not verified here to keep random access cheap, see `isRowIndexValid`
+    if (index.width != m_ihdr.width || index.height != m_ihdr.height || index.dataSize != imageData().size()) {
+        return DecodeError{DecodeErrorCode::RowIndexMismatch};
+    }
+    if (firstRow > lastRow || lastRow > m_ihdr.height) {
+        return DecodeError{DecodeErrorCode::InvalidRowsRange, 0, {firstRow, lastRow}};
+    }
+    if (firstRow == lastRow) {
+        PNG_DECODER_TRY(beginSink(sink, 0));
+        sink.end();
+        return {};
+    }
+
+    // the index is validated before the sink is begun, so that its errors leave the sink untouched
+    if (index.checkpoints.empty() || index.checkpoints.front().row > firstRow) {
+        return DecodeError{DecodeErrorCode::MissingRowCheckpoint, 0, {firstRow}};
+    }
+    const row_index::Checkpoint& checkpoint = index.nearestCheckpoint(firstRow);
 
-        scanline_reader::ScanlineReader reader(width, height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, passes[i]);
+    const std::vector<unsigned char> unused{};
+    // reader stops after `lastRow - 1`, rows below are never inflated
+    scanline_reader::ScanlineReader reader(m_ihdr.width, lastRow, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, unused);
+    PNG_DECODER_TRY(reader.tryRestore(checkpoint.row, checkpoint.previousScanline));
 
-        size_t row = 0;
-        while(reader.hasNext()) {
-            size_t fullRow = row * row_increment[i] + starting_row[i];
-            std::vector<RGB> pixels = reader.read();
+    // the prefix is a part of a single filtered row, a complete row would have been counted in `checkpoint.row`
+    if (checkpoint.rowPrefix.size() >= 1 + static_cast<size_t>(reader.getScanlineSize())) {
+        return DecodeError{DecodeErrorCode::InvalidRowCheckpoint, 0,
+                           {checkpoint.rowPrefix.size(), reader.getScanlineSize()}};
+    }
+
+    PNG_DECODER_TRY(beginSink(sink, lastRow - firstRow));
+    scanline_reader::ScanlineAssembler assembler(reader.getScanlineSize());
+    assembler.prefill(checkpoint.rowPrefix);
+    RowBuffers buffers;
 
-            for (size_t col = 0; col < pixels.size(); ++col) {
-                // calculate the position of this pixel in the full image
-                size_t fullCol = col * col_increment[i] + starting_col[i];
-                image(fullRow, fullCol) = pixels[col];
+    Expected<void> status;
+    inflate::Inflate inflateWrapper{};
+    PNG_DECODER_TRY(inflateWrapper.tryInflateFrom(imageData(), checkpoint.point, [&](const unsigned char* buffer, size_t size) {
+        return assembler.feed(buffer, size, [&](const unsigned char* bytes) {
+            const uint32_t row = reader.getRow();
+            if (row >= firstRow) {
+                status = writeRow(sink, reader, row - firstRow, bytes, buffers);
+            }
+            else if (scanline_reader::ScanlineReader::isFilterMethodValid(bytes[0])) {
+                reader.defilterFrom(bytes);
             }
-            ++row;
+            else {
+                status = DecodeError{DecodeErrorCode::InvalidFilterType, IDAT_CHUNK_TYPE, {bytes[0], row}};
+            }
+            return status.hasValue() && reader.hasNext();
+        });
+    }));
+    PNG_DECODER_TRY(status);
+
+    PNG_DECODER_TRY(validateRowsRead(reader));
+    sink.end();
+    return {};
+}
+
+
+bool PNGDecoder::isAnimated() const {
+    return m_animationControl.has_value();
+}
+
+const apng::AnimationControl& PNGDecoder::getAnimationControl() const {
+    static const apng::AnimationControl STATIC_IMAGE{1, 0};
+    return m_animationControl.has_value() ? *m_animationControl : STATIC_IMAGE;
+}
+
+
+std::vector<apng::Frame> PNGDecoder::decodeFrames() const {
+    if (!isAnimated()) {
+        apng::Frame frame{};
+        frame.control.width = m_ihdr.width;
+        frame.control.height = m_ihdr.height;
+        frame.image = tryCreateImage(Orientation::TopLeft).value();
+        return {std::move(frame)};
+    }
+
+    // all frames are returned at once
+    uint64_t pixels = 0;
+    for (const auto& frame : m_frames) {
+        pixels += static_cast<uint64_t>(frame.control.width) * frame.control.height;
+    }
+    validateMemory(pixels, sizeof(RGB)).value();
+
+    std::vector<apng::Frame> frames(m_frames.size());
+    // every frame is a zlib stream of its own, only compositing depends on the previous frames
+    // frames decoded in parallel are not split between threads any further, the pool is already full
+    const bool parallelFrames = m_options.threadsCount > 1 && m_frames.size() > 1;
+    auto decodeAt = [&](size_t i) {
+        frames[i].control = m_frames[i].control;
+        frames[i].image = tryDecodeFrame(m_frames[i], parallelFrames ? 1 : m_options.threadsCount).value();
+    };
+
+    if (parallelFrames) {
+        thread_pool::ThreadPool pool(std::min(m_options.threadsCount, m_frames.size()));
+        thread_pool::runParallel(pool, m_frames.size(), decodeAt);
+    }
+    else {
+        for (size_t i = 0; i < m_frames.size(); ++i) {
+            decodeAt(i);
+        }
+    }
+    return frames;
+}
+
+
+std::vector<Image> PNGDecoder::decodeAnimation() const {
+    std::vector<apng::Frame> frames = decodeFrames();
+
+    apng::Compositor compositor(m_ihdr.width, m_ihdr.height);
+    std::vector<Image> canvases;
+    canvases.reserve(frames.size());
+    for (auto& frame : frames) {
+        canvases.push_back(compositor.compose(frame));
+        // frame pixels are not needed after compositing
+        frame.image = Image();
+    }
+    return canvases;
+}
+
+
+Expected<Image> PNGDecoder::tryDecodeFrame(const AnimationFrame& frame, size_t threadsCount) const {
+    const PNGDecoder decoder(*this, frame, threadsCount);
+    PNG_DECODER_TRY(decoder.validateDataSize());
+    // frames are composited on the stored canvas, so they are never reoriented
+    return decoder.tryCreateImage(Orientation::TopLeft);
+}
+
+
+const std::vector<unsigned char>& PNGDecoder::imageData() const {
+    return (m_frameData != nullptr) ? *m_frameData : m_data;
+}
+
+
+const IHDR& PNGDecoder::getIHDR() const {
+    return m_ihdr;
+}
+
+const PLTE& PNGDecoder::getPLTE() const {
+    return m_plte;
+}
+
+const color::ColorInfo& PNGDecoder::getColorInfo() const {
+    return m_colorInfo;
+}
+
+std::optional<uint64_t> PNGDecoder::getContentHash() const {
+    return m_contentHash;
+}
+
+std::optional<Orientation> PNGDecoder::getExifOrientation() const {
+    return m_exifOrientation;
+}
+
+Orientation PNGDecoder::getOrientation() const {
+    return m_orientation;
+}
+
+
+Expected<void> PNGDecoder::beginSink(sink::RowSink& sink, uint32_t height) const {
+    if (sink.acceptsPackedRows()) {
+        // other color types have no indices to pack
+        if (isPaletteIndex(m_options.pixelFormat) && m_ihdr.colorType != PIXEL_PALETTE_INDEX_COLOR_TYPE) {
+            return DecodeError{DecodeErrorCode::PaletteIndexOfNonPaletteImage, IHDR_CHUNK_TYPE, {m_ihdr.colorType}};
         }
+        sink.setPackedFormat(m_options.pixelFormat);
+    }
+    sink.begin(m_ihdr.width, height);
+    for (const auto& reducer : m_options.reducers) {
+        reducer->begin(m_ihdr.width, height);
+    }
+    return {};
+}
+
+
+// converts the scanline into what the sink accepts, packed pixels are converted in place when the sink allows it
+Expected<void> PNGDecoder::writeRow(sink::RowSink& sink, scanline_reader::ScanlineReader& reader, uint32_t row,
+                                    const unsigned char* bytes, RowBuffers& buffers) const {
+    if (!scanline_reader::ScanlineReader::isFilterMethodValid(bytes[0])) {
+        return DecodeError{DecodeErrorCode::InvalidFilterType, IDAT_CHUNK_TYPE, {bytes[0], reader.getRow()}};
+    }
+
+    if (!sink.acceptsPackedRows()) {
+        reader.readFrom(bytes, buffers.pixels);
+        reduceRow(row, buffers.pixels, buffers);
+        sink.write(row, buffers.pixels);
+        return {};
+    }
+
+    unsigned char* target = packedRowTarget(sink, row, buffers);
+    if (m_colorTransform.has_value()) {
+        buffers.rgba.resize(PACKED_PIXEL_SIZE * m_ihdr.width);
+        reader.readPackedFrom(bytes, PixelFormat{}, buffers.rgba.data());
+        reduceRow(row, buffers.rgba.data());
+        m_colorTransform->apply(buffers.rgba.data(), m_ihdr.width, target);
+    }
+    else {
+        // without the transform packed rows are straight RGBA whenever there are reducers
+        reader.readPackedFrom(bytes, m_options.pixelFormat, target);
+        reduceRow(row, target);
+    }
+    sink.writePacked(row, target);
+    return {};
+}
+
+
+void PNGDecoder::reduceRow(uint32_t row, const unsigned char* rgba) const {
+    for (const auto& reducer : m_options.reducers) {
+        reducer->reduce(row, rgba, m_ihdr.width);
+    }
+}
+
+
+void PNGDecoder::reduceRow(uint32_t row, const std::vector<RGB>& pixels, RowBuffers& buffers) const {
+    if (m_options.reducers.empty()) {
+        return;
+    }
+    buffers.rgba.resize(PACKED_PIXEL_SIZE * m_ihdr.width);
+    packPixels(pixels, PixelFormat{}, buffers.rgba.data());
+    reduceRow(row, buffers.rgba.data());
+}
+
+
+unsigned char* PNGDecoder::packedRowTarget(sink::RowSink& sink, uint32_t row, RowBuffers& buffers) const {
+    unsigned char* target = sink.packedRowTarget(row);
+    if (target == nullptr) {
+        buffers.packed.resize(packedPixelSize(m_options.pixelFormat) * m_ihdr.width);
+        target = buffers.packed.data();
     }
+    return target;
+}
+
+
+/*
+* Inflates the whole image data into memory allocated once. A stream that inflates into more than the image is
+* still inflated through the end, so that its errors are not missed, but its excess bytes are not kept.
+*/
+Expected<std::vector<unsigned char>> PNGDecoder::inflateImage() const {
+    const uint64_t size = inflatedSize();
+    PNG_DECODER_TRY(validateMemory(size, 1));
+
+    std::vector<unsigned char> data;
+    data.reserve(size);
+    Expected<void> status;
+    uint64_t inflated = 0;
+    inflate::Inflate inflateWrapper{};
+    PNG_DECODER_TRY(inflateWrapper.tryInflate(imageData(), [&](const unsigned char* buffer, size_t count) {
+        inflated += count;
+        status = validateInflatedBytes(inflated);
+        const size_t kept = std::min<uint64_t>(count, size - data.size());
+        data.insert(data.end(), buffer, buffer + kept);
+        return status.hasValue();
+    }));
+    PNG_DECODER_TRY(status);
+    return data;
 }
 
 
-void PNGDecoder::fillImageNullInterlace(Image& image) const {
-    scanline_reader::ScanlineReader reader(m_ihdr.width, m_ihdr.height, m_ihdr.colorType, m_ihdr.bitDepth, m_plte, m_data);
-    size_t row = 0;
-    while(reader.hasNext()) {
-        std::vector<RGB> pixels = reader.read();
-        for (size_t col = 0; col < pixels.size(); ++col) {
-            image(row, col) = pixels[col];
+// size of the filtered scanlines of the image, i.e. of its inflated data
+uint64_t PNGDecoder::inflatedSize() const {
+    if (m_ihdr.interlaceMethod != ADAM7_INTERLACING_METHOD) {
+        return (1 + scanlineSize(m_ihdr)) * m_ihdr.height;
+    }
+
+    uint64_t size = 0;
+    for (const auto& pass : interlace::ADAM7_PASSES) {
+        IHDR passHeader = m_ihdr;
+        passHeader.width = interlace::passWidth(pass, m_ihdr.width);
+        // empty passes have no filter method bytes either
+        if (passHeader.width > 0) {
+            size += (1 + scanlineSize(passHeader)) * interlace::passHeight(pass, m_ihdr.height);
         }
-        ++row;
     }
+    return size;
+}
+
+
+// checks the limits the header alone decides, before the image data is read
+Expected<void> PNGDecoder::validateImageLimits() const {
+    const DecodeLimits& limits = m_options.limits;
+    const uint64_t pixels = static_cast<uint64_t>(m_ihdr.width) * m_ihdr.height;
+    if (pixels > limits.maxPixels) {
+        return DecodeError{DecodeErrorCode::TooManyPixels, IHDR_CHUNK_TYPE, {pixels, limits.maxPixels}};
+    }
+    return validateInflatedBytes(inflatedSize());
+}
+
+
+Expected<void> PNGDecoder::validateChunkLimits(const ChunkHeader& header, uint64_t chunksCount) const {
+    const DecodeLimits& limits = m_options.limits;
+    if (chunksCount > limits.maxChunksCount) {
+        return DecodeError{DecodeErrorCode::TooManyChunks, header.type, {chunksCount, limits.maxChunksCount}};
+    }
+    if (header.length > limits.maxChunkLength) {
+        return DecodeError{DecodeErrorCode::ChunkTooLong, header.type, {header.length, limits.maxChunkLength}};
+    }
+    return {};
+}
+
+
+Expected<void> PNGDecoder::validateInflatedBytes(uint64_t inflated) const {
+    if (inflated > m_options.limits.maxInflatedBytes) {
+        return DecodeError{DecodeErrorCode::TooManyInflatedBytes, IDAT_CHUNK_TYPE, {inflated, m_options.limits.maxInflatedBytes}};
+    }
+    return {};
+}
+
+
+// `count` objects of `size` bytes are about to be allocated, the compressed data is kept in memory while decoding
+Expected<void> PNGDecoder::validateMemory(uint64_t count, uint64_t size) const {
+    // the product is not computed when it would overflow
+    constexpr uint64_t MAX_BYTES = std::numeric_limits<uint64_t>::max();
+    const uint64_t bytes = (count > (MAX_BYTES - imageData().size()) / size) ? MAX_BYTES : imageData().size() + count * size;
+    if (bytes > m_options.limits.maxMemoryBytes) {
+        return DecodeError{DecodeErrorCode::TooMuchMemory, 0, {bytes, m_options.limits.maxMemoryBytes}};
+    }
+    return {};
+}
+
+
+// rejects geometry that the IDAT data cannot possibly hold before anything of the image size is allocated
+Expected<void> PNGDecoder::validateDataSize() const {
+    // lower bound for both interlacing methods: Adam7 passes only add filter method bytes and padding bits
+    const uint64_t pixelBytes = scanlineSize(m_ihdr) * m_ihdr.height;
+    if (pixelBytes / MAX_DEFLATE_RATIO > imageData().size()) {
+        return DecodeError{DecodeErrorCode::ImageDataTooSmall, IDAT_CHUNK_TYPE, {imageData().size(), pixelBytes}};
+    }
+    return {};
 }
 
 
-void PNGDecoder::storeIHDR(const Chunk& ihdrChunk) {
-    validateIHDR(ihdrChunk.type);
+Expected<void> PNGDecoder::validateRowsRead(const scanline_reader::ScanlineReader& reader) const {
+    if (reader.hasNext()) {
+        return DecodeError{DecodeErrorCode::TruncatedImageData, IDAT_CHUNK_TYPE, {reader.getRow(), m_ihdr.height}};
+    }
+    return {};
+}
+
+
+Expected<void> PNGDecoder::storeIHDR(const ChunkView& ihdrChunk) {
+    if (ihdrChunk.length != sizeof(m_ihdr)) {
+        return DecodeError{DecodeErrorCode::InvalidIHDRLength, IHDR_CHUNK_TYPE, {ihdrChunk.length}};
+    }
 
     // copying fields
-    assert(ihdrChunk.length == sizeof(m_ihdr));
-    std::memcpy(&m_ihdr, ihdrChunk.data.data(), ihdrChunk.length);
+    std::memcpy(&m_ihdr, ihdrChunk.data, ihdrChunk.length);
     m_ihdr.width = utils::convertFromBigEndianToHostEndianness(m_ihdr.width);
     m_ihdr.height = utils::convertFromBigEndianToHostEndianness(m_ihdr.height);
+
+    return validateIHDRFields(m_ihdr);
 }
 
-void PNGDecoder::storeIDAT(const Chunk& idatChunk) {
-    m_data.reserve(m_data.size() + idatChunk.length);
-    for (auto byte : idatChunk.data) {
-        m_data.push_back(byte);
+Expected<void> PNGDecoder::storeIDAT(std::istream& stream, const ChunkHeader& idatHeader,
+                                     std::optional<utils::XXHash64>& dataHash) {
+    // reading straight into the end of image data, so IDAT content is copied only once
+    const size_t offset = m_data.size();
+    if (!appendChunkData(stream, idatHeader.length, m_data)) {
+        return DecodeError{DecodeErrorCode::TruncatedStream, idatHeader.type};
+    }
+
+    crc::CRC crc = startChunkCRC(idatHeader.type);
+    crc.process_bytes(m_data.data() + offset, idatHeader.length);
+    if (dataHash.has_value()) {
+        dataHash->update(m_data.data() + offset, idatHeader.length);
     }
+    return readAndValidateCRC(stream, crc.checksum(), idatHeader.type);
 }
 
-void PNGDecoder::storePLTE(const Chunk& plteChunk) {
-    // copying fields
-    if (!(plteChunk.data.size() % 3 == 0 && plteChunk.length <= 256)) {
-        throw exceptions::InvalidPLTEChunkException();
+
+Expected<void> PNGDecoder::storePLTE(const ChunkView& plteChunk) {
+    if (plteChunk.length == 0 || plteChunk.length % 3 != 0 || plteChunk.length > MAX_PLTE_LENGTH) {
+        return DecodeError{DecodeErrorCode::InvalidPLTELength, PLTE_CHUNK_TYPE, {plteChunk.length}};
+    }
+    if (!m_plte.palette.empty()) {
+        return DecodeError{DecodeErrorCode::MultiplePLTE, PLTE_CHUNK_TYPE};
     }
 
+    // copying fields
     m_plte.length = plteChunk.length;
     for (size_t i = 0; i < plteChunk.length; i += 3) {
         PLTE::rgb rgb{};
@@ -192,92 +1166,467 @@ void PNGDecoder::storePLTE(const Chunk& plteChunk) {
 
         m_plte.palette.push_back(std::move(rgb));
     }
+    return {};
+}
+
+/*
+* acTL layout (big-endian): uint32 frames count, uint32 plays count.
+* Like the other ancillary chunks, invalid animation chunks are ignored: the image is decoded as a static one.
+*/
+void PNGDecoder::storeACTL(const ChunkView& actlChunk) {
+    static constexpr uint32_t ACTL_LENGTH = 8;
+
+    // acTL must precede the image data
+    if (actlChunk.length != ACTL_LENGTH || m_animationControl.has_value() || !m_data.empty()) {
+        discardAnimation();
+        return;
+    }
+
+    apng::AnimationControl control{};
+    control.framesCount = utils::readBigEndianUInt32(actlChunk.data);
+    control.playsCount = utils::readBigEndianUInt32(actlChunk.data + 4);
+    if (control.framesCount == 0) {
+        return;
+    }
+    m_animationControl = control;
+}
+
+/*
+* fcTL layout (big-endian):
+*   uint32 sequence number, uint32 width, uint32 height, uint32 x offset, uint32 y offset,
+*   uint16 delay numerator, uint16 delay denominator, uint8 dispose op, uint8 blend op.
+* The frame preceding IDAT is the default image.
+*/
+void PNGDecoder::storeFCTL(const ChunkView& fctlChunk, uint32_t& sequenceNumber) {
+    static constexpr uint32_t FCTL_LENGTH = 26;
+
+    if (!m_animationControl.has_value()) {
+        return;
+    }
+    if (fctlChunk.length != FCTL_LENGTH || utils::readBigEndianUInt32(fctlChunk.data) != sequenceNumber++) {
+        discardAnimation();
+        return;
+    }
+
+    AnimationFrame frame{};
+    apng::FrameControl& control = frame.control;
+    control.width = utils::readBigEndianUInt32(fctlChunk.data + 4);
+    control.height = utils::readBigEndianUInt32(fctlChunk.data + 8);
+    control.xOffset = utils::readBigEndianUInt32(fctlChunk.data + 12);
+    control.yOffset = utils::readBigEndianUInt32(fctlChunk.data + 16);
+    control.delayNumerator = (fctlChunk.data[20] << 8) | fctlChunk.data[21];
+    control.delayDenominator = (fctlChunk.data[22] << 8) | fctlChunk.data[23];
+    const uint8_t disposeOp = fctlChunk.data[24];
+    const uint8_t blendOp = fctlChunk.data[25];
+
+    const bool defaultImage = m_data.empty();
+    const bool valid =
+        control.width > 0 && control.height > 0 &&
+        static_cast<uint64_t>(control.xOffset) + control.width <= m_ihdr.width &&
+        static_cast<uint64_t>(control.yOffset) + control.height <= m_ihdr.height &&
+        disposeOp <= static_cast<uint8_t>(apng::DisposeOp::Previous) &&
+        blendOp <= static_cast<uint8_t>(apng::BlendOp::Over) &&
+        // the default image covers the whole canvas and only the first frame can be it
+        (!defaultImage || (m_frames.empty() && control.width == m_ihdr.width && control.height == m_ihdr.height &&
+                           control.xOffset == 0 && control.yOffset == 0)) &&
+        // every frame but the default image has data
+        (m_frames.empty() || m_frames.back().defaultImage || !m_frames.back().data.empty()) &&
+        m_frames.size() < m_animationControl->framesCount;
+    if (!valid) {
+        discardAnimation();
+        return;
+    }
+
+    control.disposeOp = static_cast<apng::DisposeOp>(disposeOp);
+    control.blendOp = static_cast<apng::BlendOp>(blendOp);
+    frame.defaultImage = defaultImage;
+    m_frames.push_back(std::move(frame));
+}
+
+/*
+* fdAT layout: uint32 sequence number (big-endian) followed by frame data continuing the zlib stream of the frame.
+*/
+void PNGDecoder::storeFDAT(const ChunkView& fdatChunk, uint32_t& sequenceNumber) {
+    if (!m_animationControl.has_value()) {
+        return;
+    }
+    // frame data follows IDAT, and the default image has none
+    if (fdatChunk.length < sizeof(uint32_t) || utils::readBigEndianUInt32(fdatChunk.data) != sequenceNumber++ ||
+            m_frames.empty() || m_data.empty() || m_frames.back().defaultImage) {
+        discardAnimation();
+        return;
+    }
+
+    std::vector<unsigned char>& data = m_frames.back().data;
+    data.insert(data.end(), fdatChunk.data + sizeof(uint32_t), fdatChunk.data + fdatChunk.length);
+}
+
+void PNGDecoder::validateAnimation() {
+    if (!m_animationControl.has_value()) {
+        return;
+    }
+
+    bool valid = m_frames.size() == m_animationControl->framesCount;
+    for (const auto& frame : m_frames) {
+        valid = valid && (frame.defaultImage || !frame.data.empty());
+    }
+    if (!valid) {
+        discardAnimation();
+    }
+}
+
+void PNGDecoder::discardAnimation() {
+    m_animationControl.reset();
+    m_frames.clear();
+}
+
+/*
+* zsEG layout (big-endian):
+*   uint32 segments count
+*   for each segment: uint32 first row, uint32 offset of the segment in the concatenated IDAT data
+* Every segment but the first one starts right after a full flush of the deflate stream.
+*/
+void PNGDecoder::storeZSEG(const ChunkView& zsegChunk) {
+    const size_t entrySize = 2 * sizeof(uint32_t);
+    if (zsegChunk.length < sizeof(uint32_t)) {
+        return;
+    }
+
+    const uint32_t count = utils::readBigEndianUInt32(zsegChunk.data);
+    if (zsegChunk.length != sizeof(uint32_t) + count * entrySize) {
+        return;
+    }
+
+    m_segments.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        const unsigned char* entry = zsegChunk.data + sizeof(uint32_t) + i * entrySize;
+
+        ImageSegment segment{};
+        segment.firstRow = utils::readBigEndianUInt32(entry);
+        segment.dataOffset = utils::readBigEndianUInt32(entry + sizeof(uint32_t));
+        m_segments.push_back(segment);
+    }
+}
+
+/*
+* iDOT layout (big-endian), as written by Apple for two segments:
+*   uint32 segments count (2), uint32 reserved (0), uint32 height of the first segment,
+*   uint32 size of the iDOT chunk (40), uint32 height of the first segment, uint32 height of the second segment,
+*   uint32 offset from the beginning of iDOT chunk to the IDAT chunk starting the second segment.
+*/
+void PNGDecoder::storeIDOT(const ChunkView& idotChunk, std::streamoff idotPosition,
+                           const std::vector<std::pair<std::streamoff, size_t>>& idatPositions) {
+    static constexpr uint32_t IDOT_LENGTH = 28;
+    static constexpr uint32_t IDOT_SEGMENTS_COUNT = 2;
+
+    if (idotChunk.length != IDOT_LENGTH || idatPositions.empty() ||
+            utils::readBigEndianUInt32(idotChunk.data) != IDOT_SEGMENTS_COUNT) {
+        return;
+    }
+
+    const uint32_t firstHeight = utils::readBigEndianUInt32(idotChunk.data + 16);
+    const uint32_t idatOffset = utils::readBigEndianUInt32(idotChunk.data + 24);
+
+    for (const auto& [position, dataOffset] : idatPositions) {
+        if (position == idotPosition + idatOffset) {
+            m_segments = {ImageSegment{0, 0, 0}, ImageSegment{firstHeight, 0, dataOffset}};
+            return;
+        }
+    }
+}
+
+void PNGDecoder::storeGAMA(const ChunkView& gamaChunk) {
+    static constexpr double GAMMA_SCALE = 100000.0;
+
+    if (gamaChunk.length != sizeof(uint32_t)) {
+        return;
+    }
+    const uint32_t gamma = utils::readBigEndianUInt32(gamaChunk.data);
+    if (gamma != 0) {
+        m_colorInfo.gamma = gamma / GAMMA_SCALE;
+    }
+}
+
+
+void PNGDecoder::storeSRGB(const ChunkView& srgbChunk) {
+    static constexpr uint8_t MAX_RENDERING_INTENT = 3;
+
+    if (srgbChunk.length != 1 || srgbChunk.data[0] > MAX_RENDERING_INTENT) {
+        return;
+    }
+    m_colorInfo.renderingIntent = srgbChunk.data[0];
+}
+
+
+/*
+* cHRM layout (big-endian): uint32 white point x, white point y, red x, red y, green x, green y, blue x, blue y,
+* every value multiplied by 100000.
+*/
+void PNGDecoder::storeCHRM(const ChunkView& chrmChunk) {
+    static constexpr double CHROMATICITY_SCALE = 100000.0;
+
+    if (chrmChunk.length != 8 * sizeof(uint32_t)) {
+        return;
+    }
+    auto value = [&](size_t i) {
+        return utils::readBigEndianUInt32(chrmChunk.data + i * sizeof(uint32_t)) / CHROMATICITY_SCALE;
+    };
+    m_colorInfo.chromaticities = color::Chromaticities{
+        value(0), value(1), value(2), value(3), value(4), value(5), value(6), value(7)};
+}
+
+
+void PNGDecoder::storeEXIF(const ChunkView& exifChunk) {
+    m_exifOrientation = orientation::parseExifOrientation(exifChunk.data, exifChunk.length);
+}
+
+
+Expected<Image> PNGDecoder::tryCreateImage(Orientation orientation) const {
+    PNG_DECODER_TRY(validateMemory(static_cast<uint64_t>(m_ihdr.width) * m_ihdr.height, sizeof(RGB)));
+    Image image;
+    sink::ImageSink sink(image, orientation);
+    PNG_DECODER_TRY(tryDecode(sink));
+    return image;
+}
+
+
+/*
+* tRNS of palette images holds alpha of the first palette entries. Like other ancillary chunks,
+* an invalid one (before PLTE or longer than the palette) is ignored; tRNS of other color types is not used.
+* Colors of decoded pixels stay opaque, alpha is reported with the indices only (see `createIndexedImage`).
+*/
+void PNGDecoder::storeTRNS(const ChunkView& trnsChunk) {
+    if (m_ihdr.colorType != PIXEL_PALETTE_INDEX_COLOR_TYPE || trnsChunk.length > m_plte.palette.size()) {
+        return;
+    }
+    m_plte.alpha.assign(trnsChunk.data, trnsChunk.data + trnsChunk.length);
+}
+
+
+// combines the hash of IDAT data with the header, the palette and its tRNS alpha, multi-byte values are hashed big-endian
+uint64_t PNGDecoder::contentHash(uint64_t dataHash) const {
+    const unsigned char header[] = {
+        static_cast<unsigned char>(m_ihdr.width >> 24), static_cast<unsigned char>(m_ihdr.width >> 16),
+        static_cast<unsigned char>(m_ihdr.width >> 8), static_cast<unsigned char>(m_ihdr.width),
+        static_cast<unsigned char>(m_ihdr.height >> 24), static_cast<unsigned char>(m_ihdr.height >> 16),
+        static_cast<unsigned char>(m_ihdr.height >> 8), static_cast<unsigned char>(m_ihdr.height),
+        m_ihdr.bitDepth, m_ihdr.colorType, m_ihdr.compressionMethod, m_ihdr.filterMethod, m_ihdr.interlaceMethod,
+    };
+
+    utils::XXHash64 hash;
+    hash.update(header, sizeof(header));
+    for (const auto& entry : m_plte.palette) {
+        const unsigned char rgb[] = {entry.red, entry.green, entry.blue};
+        hash.update(rgb, sizeof(rgb));
+    }
+    // alpha is output with the indices, so images differing only in tRNS are not duplicates
+    const uint32_t alphaCount = m_plte.alpha.size();
+    const unsigned char alphaHeader[] = {
+        static_cast<unsigned char>(alphaCount >> 24), static_cast<unsigned char>(alphaCount >> 16),
+        static_cast<unsigned char>(alphaCount >> 8), static_cast<unsigned char>(alphaCount),
+    };
+    hash.update(alphaHeader, sizeof(alphaHeader));
+    if (!m_plte.alpha.empty()) {
+        hash.update(m_plte.alpha.data(), m_plte.alpha.size());
+    }
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        const unsigned char byte = static_cast<unsigned char>(dataHash >> shift);
+        hash.update(&byte, sizeof(byte));
+    }
+    return hash.digest();
+}
+
+
+// drops the index unless segments are ordered, non-empty and cover the whole image
+void PNGDecoder::validateSegments() {
+    bool valid = m_ihdr.interlaceMethod == NULL_INTERLACING_METHOD &&
+                 !m_segments.empty() &&
+                 m_segments.front().firstRow == 0 &&
+                 m_segments.front().dataOffset == 0;
+
+    for (size_t i = 0; valid && i < m_segments.size(); ++i) {
+        const bool isLast = (i + 1 == m_segments.size());
+        const uint32_t nextRow = isLast ? m_ihdr.height : m_segments[i + 1].firstRow;
+        const size_t nextOffset = isLast ? m_data.size() : m_segments[i + 1].dataOffset;
+
+        valid = m_segments[i].firstRow < nextRow && m_segments[i].dataOffset < nextOffset;
+        if (valid) {
+            m_segments[i].rowsCount = nextRow - m_segments[i].firstRow;
+        }
+    }
+
+    if (!valid) {
+        m_segments.clear();
+    }
 }
 
 
 // static methods
-void PNGDecoder::validateSignature(uint64_t signature) {
+Expected<void> PNGDecoder::validateSignature(uint64_t signature) {
     if (signature != PNGDecoder::PNG_SIGNATURE) {
-        throw exceptions::InvalidSignatureException();
+        return DecodeError{DecodeErrorCode::InvalidSignature};
     }
+    return {};
 }
 
 
-void PNGDecoder::validateIHDR(std::uint32_t chunkType) {
+Expected<void> PNGDecoder::validateIHDR(std::uint32_t chunkType) {
     if (chunkType != PNGDecoder::IHDR_CHUNK_TYPE) {
-        throw exceptions::InvalidIHDRChunkException();
+        return DecodeError{DecodeErrorCode::MissingIHDR, chunkType};
+    }
+    return {};
+}
+
+// bytes of a non-interlaced scanline without the filter method byte, for color types accepted by `validateIHDRFields`
+uint64_t PNGDecoder::scanlineSize(const IHDR& ihdr) {
+    uint64_t samplesCount = 1;
+    switch (ihdr.colorType) {
+    case PIXEL_GRAYSCALE_ALPHA_COLOR_TYPE: samplesCount = 2; break;
+    case PIXEL_RGB_COLOR_TYPE: samplesCount = 3; break;
+    case PIXEL_RGB_ALPHA_COLOR_TYPE: samplesCount = 4; break;
+    }
+    return (ihdr.width * samplesCount * ihdr.bitDepth + 7) / 8;
+}
+
+Expected<void> PNGDecoder::validateIHDRFields(const IHDR& ihdr) {
+    if (ihdr.width == 0 || ihdr.height == 0 || ihdr.width > MAX_DIMENSION || ihdr.height > MAX_DIMENSION) {
+        return DecodeError{DecodeErrorCode::InvalidImageSize, IHDR_CHUNK_TYPE, {ihdr.width, ihdr.height}};
+    }
+
+    // See: http://www.libpng.org/pub/png/spec/1.2/PNG-Chunks.html#C.IHDR
+    bool bitDepthAllowed = false;
+    switch (ihdr.colorType) {
+    case PIXEL_GRAYSCALE_COLOR_TYPE:
+    case PIXEL_PALETTE_INDEX_COLOR_TYPE:
+        bitDepthAllowed = ihdr.bitDepth == 1 || ihdr.bitDepth == 2 || ihdr.bitDepth == 4 || ihdr.bitDepth == 8;
+        break;
+    case PIXEL_GRAYSCALE_ALPHA_COLOR_TYPE:
+    case PIXEL_RGB_COLOR_TYPE:
+    case PIXEL_RGB_ALPHA_COLOR_TYPE:
+        bitDepthAllowed = ihdr.bitDepth == 8;
+        break;
+    default:
+        return DecodeError{DecodeErrorCode::UnsupportedColorType, IHDR_CHUNK_TYPE, {ihdr.colorType}};
+    }
+
+    // 16-bit samples are valid PNG, but pixel strategies only read one byte per sample
+    if (!bitDepthAllowed) {
+        return DecodeError{DecodeErrorCode::UnsupportedBitDepth, IHDR_CHUNK_TYPE, {ihdr.bitDepth, ihdr.colorType}};
+    }
+
+    if (ihdr.compressionMethod != 0 || ihdr.filterMethod != 0) {
+        return DecodeError{
+            DecodeErrorCode::UnsupportedCompressionMethod, IHDR_CHUNK_TYPE, {ihdr.compressionMethod, ihdr.filterMethod}};
+    }
+    if (ihdr.interlaceMethod != NULL_INTERLACING_METHOD && ihdr.interlaceMethod != ADAM7_INTERLACING_METHOD) {
+        return DecodeError{DecodeErrorCode::InvalidInterlaceMethod, IHDR_CHUNK_TYPE, {ihdr.interlaceMethod}};
+    }
+
+    // scanline sizes are kept in 32 bits, together with the filter method byte
+    if (scanlineSize(ihdr) >= UINT32_MAX) {
+        return DecodeError{DecodeErrorCode::ImageTooWide, IHDR_CHUNK_TYPE, {ihdr.width}};
     }
+    return {};
 }
 
-void PNGDecoder::validateCRC(uint32_t actual, uint32_t expected, uint32_t chunkType) {
+Expected<void> PNGDecoder::validateCRC(uint32_t actual, uint32_t expected, uint32_t chunkType) {
     if (actual != expected) {
-        std::string message = "Invalid CRC chunk type '" + utils::stringifyChunkType(chunkType) +
-                "': actual=" + std::to_string(actual) + ", expected=" + std::to_string(expected);
-        throw exceptions::InvalidCRCException(PNG_DECODER_ERROR_MESSAGE(message));
+        return DecodeError{DecodeErrorCode::InvalidCRC, chunkType, {actual, expected}};
     }
+    return {};
 }
 
 
-Chunk PNGDecoder::readChunk(std::istream& stream) {
-    Chunk chunk;
+Expected<ChunkHeader> PNGDecoder::readChunkHeader(std::istream& stream) {
+    ChunkHeader header;
 
     // reading length
-    utils::readFromBigEndianAndConvertToHostEndianess(
-        stream,
-        &chunk.length,
-        sizeof(chunk.length),
-        PNG_DECODER_ERROR_MESSAGE("Cannot read chunk length")
-    );
-
-    // reading type and data for following crc checking
-    uint32_t computedCRC = 0;
-    {
-        size_t bufferSize = sizeof(chunk.type) + chunk.length;
-        std::vector<char> buffer(bufferSize);
-        if (!stream.read(buffer.data(), buffer.size())) {
-            throw exceptions::InvalidStreamException(
-                PNG_DECODER_ERROR_MESSAGE("Cannot read chunk type and data into buffer"));
-        }
-
-        // computing crc
-        computedCRC = crc::computeCRCFrom(buffer);
+    if (!utils::readFromBigEndianAndConvertToHostEndianess(stream, &header.length, sizeof(header.length))) {
+        return DecodeError{DecodeErrorCode::TruncatedStream};
+    }
 
-        // moving stream back
-        stream.seekg(-1UL * bufferSize, stream.cur);
+    // see: http://www.libpng.org/pub/png/spec/1.2/PNG-Structure.html#Chunk-layout
+    if (header.length > MAX_CHUNK_LENGTH) {
+        return DecodeError{DecodeErrorCode::InvalidChunkLength, 0, {header.length}};
     }
 
     // reading type
-    utils::readFromBigEndianAndConvertToHostEndianess(
-        stream,
-        &chunk.type,
-        sizeof(chunk.type),
-        PNG_DECODER_ERROR_MESSAGE("Cannot read chunk type")
-    );
-
-    // reading chunk data
-    chunk.data.resize(chunk.length);
-    for (size_t i = 0; i < chunk.length; ++i) {
-        if (!stream.read(reinterpret_cast<char*>(&chunk.data[i]), sizeof(chunk.data[i]))) {
-            throw exceptions::InvalidStreamException(
-                PNG_DECODER_ERROR_MESSAGE("Cannot read chunk data at position " + std::to_string(i)));
-        }
-    }
-
-    // reading crc
-    utils::readFromBigEndianAndConvertToHostEndianess(
-        stream,
-        &chunk.crc,
-        sizeof(chunk.crc),
-        PNG_DECODER_ERROR_MESSAGE("Cannot read chunk crc")
-    );
+    if (!utils::readFromBigEndianAndConvertToHostEndianess(stream, &header.type, sizeof(header.type))) {
+        return DecodeError{DecodeErrorCode::TruncatedStream};
+    }
 
-    // validating actual crc against chunk crc
-    validateCRC(computedCRC, chunk.crc, chunk.type);
+    return header;
+}
+
+
+Expected<ChunkView> PNGDecoder::readChunk(std::istream& stream, const ChunkHeader& header, std::vector<unsigned char>& buffer) {
+    ChunkView chunk{header.type, nullptr, header.length};
+
+    // chunks of in-memory images are viewed in place
+    auto* memory = dynamic_cast<utils::MemoryStreamBuffer*>(stream.rdbuf());
+    if (memory != nullptr && memory->available() >= header.length) {
+        chunk.data = reinterpret_cast<const unsigned char*>(memory->current());
+        stream.seekg(header.length, std::ios_base::cur);
+    }
+    else {
+        buffer.clear();
+        if (!appendChunkData(stream, header.length, buffer)) {
+            return DecodeError{DecodeErrorCode::TruncatedStream, header.type};
+        }
+        chunk.data = buffer.data();
+    }
+
+    crc::CRC crc = startChunkCRC(header.type);
+    crc.process_bytes(chunk.data, chunk.length);
+    PNG_DECODER_TRY(readAndValidateCRC(stream, crc.checksum(), header.type));
 
     return chunk;
 }
 
 
+Expected<void> PNGDecoder::skipChunk(std::istream& stream, const ChunkHeader& header, bool verifyCRC) {
+    // data and crc
+    const std::streamoff skippedSize = static_cast<std::streamoff>(header.length) + sizeof(uint32_t);
+
+    if (!verifyCRC) {
+        if (stream.seekg(skippedSize, std::ios_base::cur)) {
+            return {};
+        }
+
+        // stream is not seekable (e.g. pipe)
+        stream.clear();
+        if (!stream.ignore(skippedSize) || stream.gcount() != skippedSize) {
+            return DecodeError{DecodeErrorCode::TruncatedStream, header.type};
+        }
+        return {};
+    }
+
+    // reading through a small block, so memory usage does not depend on chunk size
+    crc::CRC crc = startChunkCRC(header.type);
+    char block[SKIP_BLOCK_SIZE];
+    for (uint32_t remaining = header.length; remaining > 0;) {
+        const uint32_t size = std::min<uint32_t>(remaining, sizeof(block));
+        if (!stream.read(block, size)) {
+            return DecodeError{DecodeErrorCode::TruncatedStream, header.type};
+        }
+        crc.process_bytes(block, size);
+        remaining -= size;
+    }
+    return readAndValidateCRC(stream, crc.checksum(), header.type);
+}
+
+
+Expected<void> PNGDecoder::readAndValidateCRC(std::istream& stream, uint32_t computedCRC, uint32_t chunkType) {
+    uint32_t chunkCRC = 0;
+    if (!utils::readFromBigEndianAndConvertToHostEndianess(stream, &chunkCRC, sizeof(chunkCRC))) {
+        return DecodeError{DecodeErrorCode::TruncatedStream, chunkType};
+    }
+
+    // validating actual crc against chunk crc
+    return validateCRC(computedCRC, chunkCRC, chunkType);
+}
+
+
 bool PNGDecoder::isIEND(uint32_t chunkType) noexcept {
     return chunkType == PNGDecoder::IEND_CHUNK_TYPE;
 }
@@ -290,14 +1639,77 @@ bool PNGDecoder::isPLTE(uint32_t chunkType) noexcept {
     return chunkType == PNGDecoder::PLTE_CHUNK_TYPE;
 }
 
+bool PNGDecoder::isZSEG(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::ZSEG_CHUNK_TYPE;
+}
+
+bool PNGDecoder::isACTL(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::ACTL_CHUNK_TYPE;
+}
+
+bool PNGDecoder::isFCTL(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::FCTL_CHUNK_TYPE;
+}
+
+bool PNGDecoder::isFDAT(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::FDAT_CHUNK_TYPE;
+}
+
+bool PNGDecoder::isIDOT(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::IDOT_CHUNK_TYPE;
+}
+
+
+bool PNGDecoder::isGAMA(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::GAMA_CHUNK_TYPE;
+}
+
+
+bool PNGDecoder::isSRGB(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::SRGB_CHUNK_TYPE;
+}
+
+
+bool PNGDecoder::isCHRM(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::CHRM_CHUNK_TYPE;
+}
+
+
+bool PNGDecoder::isEXIF(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::EXIF_CHUNK_TYPE;
+}
+
+
+bool PNGDecoder::isTRNS(uint32_t chunkType) noexcept {
+    return chunkType == PNGDecoder::TRNS_CHUNK_TYPE;
+}
+
 
 } // namespace png_decoder
 
 
 Image ReadPng(std::string_view filename) {
+    return TryReadPng(filename).value();
+}
+
+void ReadPng(std::string_view filename, png_decoder::sink::RowSink& sink) {
+    TryReadPng(filename, sink).value();
+}
+
+png_decoder::Expected<Image> TryReadPng(std::string_view filename) {
     std::string path(filename);
     std::fstream file(path);
 
-    png_decoder::PNGDecoder decoder(file);
-    return decoder.createImage();
-}
\ No newline at end of file
+    png_decoder::Expected<png_decoder::PNGDecoder> decoder = png_decoder::PNGDecoder::tryCreate(file);
+    PNG_DECODER_TRY(decoder);
+    return decoder->tryCreateImage();
+}
+
+png_decoder::Expected<void> TryReadPng(std::string_view filename, png_decoder::sink::RowSink& sink) {
+    std::string path(filename);
+    std::fstream file(path);
+
+    png_decoder::Expected<png_decoder::PNGDecoder> decoder = png_decoder::PNGDecoder::tryCreate(file);
+    PNG_DECODER_TRY(decoder);
+    return decoder->tryDecode(sink);
+}
@@ -4,34 +4,199 @@
 #include <istream>
 #include <string>
 #include <vector>
+#include <utility>
+#include <optional>
 
 #include "misc/structs.h"
+#include "misc/options.h"
+#include "misc/expected.h"
+#include "sink/sink.h"
+#include "sink/index_sink.h"
+#include "thread-pool/thread_pool.h"
+#include "scanline-reader/scanline_reader.h"
+#include "row-index/row_index.h"
+#include "color/color_transform.h"
+#include "apng/apng.h"
+#include "utils/hash.h"
 #include "image.h"
 
 
 namespace png_decoder {
 
+/*
+* Parsing happens in the constructor; afterwards the decoder is never modified, so its const methods may be called
+* from several threads at once. Sinks, reducers and chunk handlers are not synchronized by the decoder.
+*/
 class PNGDecoder {
 public:
-    PNGDecoder(std::istream& stream);
+    PNGDecoder(std::istream& stream, DecodeOptions options = {});
+    /* upright image, see `DecodeOptions::orientation` */
     Image createImage() const;
+    /* streams decoded rows into the sink in top to bottom order */
+    void decode(sink::RowSink& sink) const;
+    /*
+    * decodes packed pixels of `DecodeOptions::pixelFormat` into the top left corner of the view,
+    * upright, so a transposing orientation needs a view of `height` x `width` pixels
+    */
+    void decode(const image_view::ImageView& view) const;
+
+    /*
+    * Same as the constructor and the methods above, returning the reason a corrupt image is rejected
+    * instead of throwing it. Exceptions of sinks and chunk handlers, and std::bad_alloc, still propagate.
+    */
+    static Expected<PNGDecoder> tryCreate(std::istream& stream, DecodeOptions options = {});
+    Expected<Image> tryCreateImage() const;
+    Expected<void> tryDecode(sink::RowSink& sink) const;
+    Expected<void> tryDecode(const image_view::ImageView& view) const;
+
+    /*
+    * Palette images only: the palette with its tRNS alpha and the index of every pixel instead of its color.
+    * Bytes are upright like `createImage`, bit-packed rows keep the layout of PNG rows. Reducers are not fed.
+    */
+    sink::IndexedImage createIndexedImage(sink::IndexLayout layout = sink::IndexLayout::Bytes) const;
+    Expected<sink::IndexedImage> tryCreateIndexedImage(sink::IndexLayout layout = sink::IndexLayout::Bytes) const;
+
+    /* single pass over the image data recording checkpoints at least `rowsPerCheckpoint` rows apart */
+    row_index::RowIndex buildRowIndex(uint32_t rowsPerCheckpoint) const;
+    /* whether the index was built for this image (compares geometry and checksum of the image data) */
+    bool isRowIndexValid(const row_index::RowIndex& index) const;
+    /* decodes rows [firstRow, lastRow) resuming from the nearest checkpoint of the index */
+    Image decodeRows(const row_index::RowIndex& index, uint32_t firstRow, uint32_t lastRow) const;
+    void decodeRows(const row_index::RowIndex& index, uint32_t firstRow, uint32_t lastRow, sink::RowSink& sink) const;
+    /* same as the row index methods above, returning the reason the image or the index is rejected */
+    Expected<row_index::RowIndex> tryBuildRowIndex(uint32_t rowsPerCheckpoint) const;
+    Expected<Image> tryDecodeRows(const row_index::RowIndex& index, uint32_t firstRow, uint32_t lastRow) const;
+    Expected<void> tryDecodeRows(const row_index::RowIndex& index, uint32_t firstRow, uint32_t lastRow,
+                                 sink::RowSink& sink) const;
+
+    /* whether the image is a valid APNG, the default image is decoded instead of an animation with invalid chunks */
+    bool isAnimated() const;
+    const apng::AnimationControl& getAnimationControl() const;
+    /* decodes frame regions concurrently on `DecodeOptions::threadsCount` threads, a static image is a single frame */
+    std::vector<apng::Frame> decodeFrames() const;
+    /* canvases displayed for every frame: frames are decoded concurrently, then composited in order */
+    std::vector<Image> decodeAnimation() const;
+
+    const IHDR& getIHDR() const;
+    /* palette (also the suggested palette of truecolor images) and tRNS alpha of palette images */
+    const PLTE& getPLTE() const;
+    const color::ColorInfo& getColorInfo() const;
+    /*
+    * XXH64 of IHDR, PLTE, tRNS alpha of palette images and the concatenated IDAT data if `DecodeOptions::hashContent`
+    * is set, empty otherwise. Files differing only in other ancillary chunks (color space ones included) or in the split
+    * of IDAT chunks hash equally.
+    * Parsing inflates nothing, so duplicates can be looked up before `decode`; `reducer::PixelHashReducer`
+    * also matches images whose image data was encoded differently.
+    */
+    std::optional<uint64_t> getContentHash() const;
+    /* orientation stored in eXIf chunk, empty if there is none or it is invalid */
+    std::optional<Orientation> getExifOrientation() const;
+    /* orientation applied by `createImage` and `decode(view)` */
+    Orientation getOrientation() const;
 
 private:
-    void storeIHDR(const Chunk& ihdrChunk);
-    void storeIDAT(const Chunk& idatChunk);
-    void storePLTE(const Chunk& plteChunk);
-    void fillImageNullInterlace(Image& image) const;
-    void fillImageAdam7Interlace(Image& image) const;
+    // per-thread buffers reused by every converted row
+    struct RowBuffers {
+        // pixels of rows written to sinks not accepting packed rows
+        std::vector<RGB> pixels;
+        // straight 8-bit RGBA input of the color transform and of reducers
+        std::vector<unsigned char> rgba;
+        // used if the sink does not provide memory for the row
+        std::vector<unsigned char> packed;
+    };
 
+    // frame of an APNG animation
+    struct AnimationFrame {
+        apng::FrameControl control;
+        // the frame is the default image, its data is `m_data`
+        bool defaultImage = false;
+        // concatenated fdAT data without sequence numbers
+        std::vector<unsigned char> data;
+    };
 
 private:
-    static void validateSignature(uint64_t signature);
-    static void validateIHDR(uint32_t chunkType);
-    static void validateCRC(uint32_t actual, uint32_t expected, uint32_t chunkType);
-    static Chunk readChunk(std::istream& stream);
+    /* decoder without any image, filled by `parse` */
+    explicit PNGDecoder(DecodeOptions options);
+    /*
+    * decoder of a single animation frame sharing the header, palette and options of the image;
+    * it refers to the data of the frame instead of copying it, so it must not outlive `image`
+    */
+    PNGDecoder(const PNGDecoder& image, const AnimationFrame& frame, size_t threadsCount);
+
+    Expected<void> parse(std::istream& stream);
+    Expected<void> storeIHDR(const ChunkView& ihdrChunk);
+    Expected<void> storeIDAT(std::istream& stream, const ChunkHeader& idatHeader, std::optional<utils::XXHash64>& dataHash);
+    Expected<void> storePLTE(const ChunkView& plteChunk);
+    void storeZSEG(const ChunkView& zsegChunk);
+    void storeGAMA(const ChunkView& gamaChunk);
+    void storeSRGB(const ChunkView& srgbChunk);
+    void storeCHRM(const ChunkView& chrmChunk);
+    void storeTRNS(const ChunkView& trnsChunk);
+    void storeACTL(const ChunkView& actlChunk);
+    void storeFCTL(const ChunkView& fctlChunk, uint32_t& sequenceNumber);
+    void storeFDAT(const ChunkView& fdatChunk, uint32_t& sequenceNumber);
+    void validateAnimation();
+    void discardAnimation();
+    Expected<Image> tryDecodeFrame(const AnimationFrame& frame, size_t threadsCount) const;
+    // compressed data being decoded: `m_data` of images, data of the frame for frame decoders
+    const std::vector<unsigned char>& imageData() const;
+    void storeEXIF(const ChunkView& exifChunk);
+    void storeIDOT(const ChunkView& idotChunk, std::streamoff idotPosition,
+                   const std::vector<std::pair<std::streamoff, size_t>>& idatPositions);
+    void validateSegments();
+    uint64_t contentHash(uint64_t dataHash) const;
+    Expected<Image> tryCreateImage(Orientation orientation) const;
+    Expected<void> decodeNullInterlace(sink::RowSink& sink) const;
+    Expected<void> decodeAdam7Interlace(sink::RowSink& sink, const std::vector<unsigned char>& data) const;
+    Expected<void> beginSink(sink::RowSink& sink, uint32_t height) const;
+    Expected<void> writeRow(sink::RowSink& sink, scanline_reader::ScanlineReader& reader, uint32_t row,
+                            const unsigned char* bytes, RowBuffers& buffers) const;
+    unsigned char* packedRowTarget(sink::RowSink& sink, uint32_t row, RowBuffers& buffers) const;
+    /* passes straight 8-bit RGBA row to the reducers */
+    void reduceRow(uint32_t row, const unsigned char* rgba) const;
+    void reduceRow(uint32_t row, const std::vector<RGB>& pixels, RowBuffers& buffers) const;
+    Expected<std::vector<unsigned char>> inflateImage() const;
+    uint64_t inflatedSize() const;
+    Expected<void> validateImageLimits() const;
+    Expected<void> validateChunkLimits(const ChunkHeader& header, uint64_t chunksCount) const;
+    Expected<void> validateInflatedBytes(uint64_t inflated) const;
+    Expected<void> validateMemory(uint64_t count, uint64_t size) const;
+    Expected<void> validateDataSize() const;
+    Expected<void> validateRowsRead(const scanline_reader::ScanlineReader& reader) const;
+    bool inflateSegments(thread_pool::ThreadPool& pool, std::vector<unsigned char>& data) const;
+    Expected<void> decodeSegments(sink::RowSink& sink, thread_pool::ThreadPool& pool, std::vector<unsigned char>& data) const;
+    /* whether rows of the whole inflated image are worth converting in bands on several threads */
+    bool convertsInBands(const sink::RowSink& sink) const;
+    /* defilters the inflated image `data` in place on this thread and converts its rows in bands on the pool */
+    Expected<void> decodeBands(sink::RowSink& sink, thread_pool::ThreadPool& pool, std::vector<unsigned char>& data) const;
+
+
+private:
+    static Expected<void> validateSignature(uint64_t signature);
+    static Expected<void> validateIHDR(uint32_t chunkType);
+    /* checks once per image everything the per-pixel loops rely on */
+    static Expected<void> validateIHDRFields(const IHDR& ihdr);
+    static uint64_t scanlineSize(const IHDR& ihdr);
+    static Expected<void> validateCRC(uint32_t actual, uint32_t expected, uint32_t chunkType);
+    static Expected<ChunkHeader> readChunkHeader(std::istream& stream);
+    /* reads data of the chunk and validates its crc, the view refers either to the stream memory or to `buffer` */
+    static Expected<ChunkView> readChunk(std::istream& stream, const ChunkHeader& header, std::vector<unsigned char>& buffer);
+    /* moves the stream past the chunk without buffering its data */
+    static Expected<void> skipChunk(std::istream& stream, const ChunkHeader& header, bool verifyCRC);
+    static Expected<void> readAndValidateCRC(std::istream& stream, uint32_t computedCRC, uint32_t chunkType);
     static bool isIEND(uint32_t chunkType) noexcept;
     static bool isIDAT(uint32_t chunkType) noexcept;
     static bool isPLTE(uint32_t chunkType) noexcept;
+    static bool isZSEG(uint32_t chunkType) noexcept;
+    static bool isIDOT(uint32_t chunkType) noexcept;
+    static bool isGAMA(uint32_t chunkType) noexcept;
+    static bool isSRGB(uint32_t chunkType) noexcept;
+    static bool isCHRM(uint32_t chunkType) noexcept;
+    static bool isEXIF(uint32_t chunkType) noexcept;
+    static bool isTRNS(uint32_t chunkType) noexcept;
+    static bool isACTL(uint32_t chunkType) noexcept;
+    static bool isFCTL(uint32_t chunkType) noexcept;
+    static bool isFDAT(uint32_t chunkType) noexcept;
 
 private:
     static constexpr uint64_t PNG_SIGNATURE = 0x89504E470D0A1A0A; // 137 80 78 71 13 10 26 10
@@ -39,17 +204,66 @@ private:
     static constexpr uint32_t PLTE_CHUNK_TYPE = 0x504c5445UL; // 80 76 84 69
     static constexpr uint32_t IDAT_CHUNK_TYPE = 0x49444154UL; // 73 68 65 84
     static constexpr uint32_t IEND_CHUNK_TYPE = 0x49454e44UL; // 73 69 78 68
+    // Apple's index of IDAT segments, see: https://www.hackerfactor.com/blog/index.php?/archives/895-Connecting-the-iDOTs.html
+    static constexpr uint32_t IDOT_CHUNK_TYPE = 0x69444f54UL; // 105 68 79 84
+    // private index of IDAT segments written by `encoder::PNGEncoder`
+    static constexpr uint32_t ZSEG_CHUNK_TYPE = 0x7a734547UL; // 122 115 69 71
+    static constexpr uint32_t GAMA_CHUNK_TYPE = 0x67414d41UL; // 103 65 77 65
+    static constexpr uint32_t SRGB_CHUNK_TYPE = 0x73524742UL; // 115 82 71 66
+    static constexpr uint32_t CHRM_CHUNK_TYPE = 0x6348524dUL; // 99 72 82 77
+    static constexpr uint32_t EXIF_CHUNK_TYPE = 0x65584966UL; // 101 88 73 102
+    static constexpr uint32_t TRNS_CHUNK_TYPE = 0x74524e53UL; // 116 82 78 83
+    // APNG, see: https://wiki.mozilla.org/APNG_Specification
+    static constexpr uint32_t ACTL_CHUNK_TYPE = 0x6163544cUL; // 97 99 84 76
+    static constexpr uint32_t FCTL_CHUNK_TYPE = 0x6663544cUL; // 102 99 84 76
+    static constexpr uint32_t FDAT_CHUNK_TYPE = 0x66644154UL; // 102 100 65 84
+
+    static constexpr uint32_t MAX_CHUNK_LENGTH = 0x7FFFFFFFUL; // 2^31 - 1
+    static constexpr uint32_t MAX_DIMENSION = 0x7FFFFFFFUL; // 2^31 - 1
+    static constexpr uint32_t MAX_PLTE_LENGTH = 3 * 256;
+    // deflate cannot expand data more than 1032 times (258 bytes per at least 2 bits)
+    static constexpr uint64_t MAX_DEFLATE_RATIO = 1032;
+    static constexpr size_t SKIP_BLOCK_SIZE = 4096;
+    // smaller images are converted on one thread, the pool would cost more than the conversion
+    static constexpr uint64_t MIN_BAND_CONVERSION_PIXELS = 1 << 20;
+    // bands per pool thread, so that a slow band does not leave other threads idle
+    static constexpr size_t BANDS_PER_THREAD = 4;
 
     static constexpr uint32_t NULL_INTERLACING_METHOD = 0;
     static constexpr uint32_t ADAM7_INTERLACING_METHOD = 1;
+
+    static constexpr uint8_t PIXEL_GRAYSCALE_COLOR_TYPE = 0;
+    static constexpr uint8_t PIXEL_RGB_COLOR_TYPE = 2;
+    static constexpr uint8_t PIXEL_PALETTE_INDEX_COLOR_TYPE = 3;
+    static constexpr uint8_t PIXEL_GRAYSCALE_ALPHA_COLOR_TYPE = 4;
+    static constexpr uint8_t PIXEL_RGB_ALPHA_COLOR_TYPE = 6;
 private:
+    DecodeOptions m_options;
     IHDR m_ihdr;
     PLTE m_plte;
+    // concatenated content of IDAT chunks, inflated lazily on decoding
     std::vector<unsigned char> m_data;
+    // data of the decoded frame owned by its image, null unless this is a frame decoder
+    const std::vector<unsigned char>* m_frameData;
+    // independently inflatable parts of `m_data`, empty if the image has no valid index
+    std::vector<ImageSegment> m_segments;
+    color::ColorInfo m_colorInfo;
+    // empty if packed pixels are plain 8-bit samples
+    std::optional<color::ColorTransform> m_colorTransform;
+    // empty if the image is not animated
+    std::optional<apng::AnimationControl> m_animationControl;
+    std::vector<AnimationFrame> m_frames;
+    std::optional<uint64_t> m_contentHash;
+    std::optional<Orientation> m_exifOrientation;
+    Orientation m_orientation;
 };
 
 
 }; // namespace png_decoder
 
 
-Image ReadPng(std::string_view filename);
\ No newline at end of file
+Image ReadPng(std::string_view filename);
+void ReadPng(std::string_view filename, png_decoder::sink::RowSink& sink);
+/* same as `ReadPng`, returning the reason a corrupt image is rejected instead of throwing it */
+png_decoder::Expected<Image> TryReadPng(std::string_view filename);
+png_decoder::Expected<void> TryReadPng(std::string_view filename, png_decoder::sink::RowSink& sink);
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include "reducer.h"
+
+
+namespace png_decoder::reducer {
+
+// OpacityReducer
+void OpacityReducer::begin([[maybe_unused]] uint32_t width, [[maybe_unused]] uint32_t height) {
+    m_opaque = true;
+}
+
+void OpacityReducer::reduce([[maybe_unused]] uint32_t row, const unsigned char* rgba, uint32_t width) {
+    // the answer is known after the first transparent pixel
+    if (!m_opaque) {
+        return;
+    }
+
+    // branchless over the row, so the loop is vectorized
+    uint8_t alpha = 0xFF;
+    for (uint32_t i = 0; i < width; ++i) {
+        alpha &= rgba[4 * i + 3];
+    }
+    m_opaque = (alpha == 0xFF);
+}
+
+bool OpacityReducer::isOpaque() const {
+    return m_opaque;
+}
+
+
+// GrayscaleReducer
+void GrayscaleReducer::begin([[maybe_unused]] uint32_t width, [[maybe_unused]] uint32_t height) {
+    m_grayscale = true;
+}
+
+void GrayscaleReducer::reduce([[maybe_unused]] uint32_t row, const unsigned char* rgba, uint32_t width) {
+    if (!m_grayscale) {
+        return;
+    }
+
+    uint8_t difference = 0;
+    for (uint32_t i = 0; i < width; ++i) {
+        const unsigned char* pixel = rgba + 4 * i;
+        difference |= (pixel[0] ^ pixel[1]) | (pixel[1] ^ pixel[2]);
+    }
+    m_grayscale = (difference == 0);
+}
+
+bool GrayscaleReducer::isGrayscale() const {
+    return m_grayscale;
+}
+
+
+// HistogramReducer
+void HistogramReducer::begin([[maybe_unused]] uint32_t width, [[maybe_unused]] uint32_t height) {
+    for (auto& histogram : m_histograms) {
+        histogram.fill(0);
+    }
+}
+
+void HistogramReducer::reduce([[maybe_unused]] uint32_t row, const unsigned char* rgba, uint32_t width) {
+    for (uint32_t i = 0; i < width; ++i) {
+        const unsigned char* pixel = rgba + 4 * i;
+        ++m_histograms[0][pixel[0]];
+        ++m_histograms[1][pixel[1]];
+        ++m_histograms[2][pixel[2]];
+        ++m_histograms[3][pixel[3]];
+    }
+}
+
+const HistogramReducer::Histogram& HistogramReducer::histogram(size_t channel) const {
+    return m_histograms[channel];
+}
+
+
+// StatisticsReducer
+void StatisticsReducer::begin([[maybe_unused]] uint32_t width, [[maybe_unused]] uint32_t height) {
+    m_min.fill(0xFF);
+    m_max.fill(0);
+    m_sums.fill(0);
+    m_pixelsCount = 0;
+}
+
+void StatisticsReducer::reduce([[maybe_unused]] uint32_t row, const unsigned char* rgba, uint32_t width) {
+    // accumulating in locals, so the compiler keeps them in registers instead of reloading the members
+    std::array<uint8_t, 4> rowMin = m_min;
+    std::array<uint8_t, 4> rowMax = m_max;
+    std::array<uint64_t, 4> rowSums{};
+    for (uint32_t i = 0; i < width; ++i) {
+        const unsigned char* pixel = rgba + 4 * i;
+        for (size_t channel = 0; channel < 4; ++channel) {
+            rowMin[channel] = std::min(rowMin[channel], pixel[channel]);
+            rowMax[channel] = std::max(rowMax[channel], pixel[channel]);
+            rowSums[channel] += pixel[channel];
+        }
+    }
+
+    m_min = rowMin;
+    m_max = rowMax;
+    for (size_t channel = 0; channel < 4; ++channel) {
+        m_sums[channel] += rowSums[channel];
+    }
+    m_pixelsCount += width;
+}
+
+std::array<uint8_t, 4> StatisticsReducer::min() const {
+    return m_min;
+}
+
+std::array<uint8_t, 4> StatisticsReducer::max() const {
+    return m_max;
+}
+
+std::array<double, 4> StatisticsReducer::mean() const {
+    std::array<double, 4> mean{};
+    if (m_pixelsCount == 0) {
+        return mean;
+    }
+    for (size_t channel = 0; channel < 4; ++channel) {
+        mean[channel] = static_cast<double>(m_sums[channel]) / m_pixelsCount;
+    }
+    return mean;
+}
+
+
+// PixelHashReducer
+void PixelHashReducer::begin(uint32_t width, uint32_t height) {
+    m_hash = utils::XXHash64();
+
+    const unsigned char size[] = {
+        static_cast<unsigned char>(width >> 24), static_cast<unsigned char>(width >> 16),
+        static_cast<unsigned char>(width >> 8), static_cast<unsigned char>(width),
+        static_cast<unsigned char>(height >> 24), static_cast<unsigned char>(height >> 16),
+        static_cast<unsigned char>(height >> 8), static_cast<unsigned char>(height),
+    };
+    m_hash.update(size, sizeof(size));
+}
+
+void PixelHashReducer::reduce([[maybe_unused]] uint32_t row, const unsigned char* rgba, uint32_t width) {
+    m_hash.update(rgba, 4 * static_cast<size_t>(width));
+}
+
+uint64_t PixelHashReducer::digest() const {
+    return m_hash.digest();
+}
+
+} // namespace png_decoder::reducer
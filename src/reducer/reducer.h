@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/hash.h"
+
+
+namespace png_decoder::reducer {
+
+/*
+* Computes a summary of the image from its decoded rows, see `DecodeOptions::reducers`.
+* The decoder calls `begin` once per decoding, then `reduce` for every row in top to bottom order, on one thread,
+* right after the row is converted and while it is still in cache, so no extra pass over the image is needed.
+* Rows are straight 8-bit RGBA pixels whatever format the sink receives.
+*/
+class RowReducer {
+public:
+    virtual ~RowReducer() = default;
+
+    /* resets the summary, a reducer can be reused for several decodings */
+    virtual void begin(uint32_t width, uint32_t height) = 0;
+    virtual void reduce(uint32_t row, const unsigned char* rgba, uint32_t width) = 0;
+};
+
+
+// whether every pixel is fully opaque, so the alpha channel can be dropped
+class OpacityReducer : public RowReducer {
+public:
+    void begin(uint32_t width, uint32_t height) override;
+    void reduce(uint32_t row, const unsigned char* rgba, uint32_t width) override;
+
+    bool isOpaque() const;
+
+private:
+    bool m_opaque = true;
+};
+
+
+// whether every pixel has equal red, green and blue samples, i.e. an RGB image holds grayscale content
+class GrayscaleReducer : public RowReducer {
+public:
+    void begin(uint32_t width, uint32_t height) override;
+    void reduce(uint32_t row, const unsigned char* rgba, uint32_t width) override;
+
+    bool isGrayscale() const;
+
+private:
+    bool m_grayscale = true;
+};
+
+
+// 256-bin histogram of every channel, channels in RGBA order
+class HistogramReducer : public RowReducer {
+public:
+    using Histogram = std::array<uint64_t, 256>;
+
+    void begin(uint32_t width, uint32_t height) override;
+    void reduce(uint32_t row, const unsigned char* rgba, uint32_t width) override;
+
+    const Histogram& histogram(size_t channel) const;
+
+private:
+    std::array<Histogram, 4> m_histograms{};
+};
+
+
+// minimum, maximum and mean of every channel, channels in RGBA order
+class StatisticsReducer : public RowReducer {
+public:
+    void begin(uint32_t width, uint32_t height) override;
+    void reduce(uint32_t row, const unsigned char* rgba, uint32_t width) override;
+
+    /* min() and max() of an empty image are 255 and 0, mean() is 0 */
+    std::array<uint8_t, 4> min() const;
+    std::array<uint8_t, 4> max() const;
+    std::array<double, 4> mean() const;
+
+private:
+    std::array<uint8_t, 4> m_min{};
+    std::array<uint8_t, 4> m_max{};
+    std::array<uint64_t, 4> m_sums{};
+    uint64_t m_pixelsCount = 0;
+};
+
+
+/*
+* XXH64 of the image size and its straight RGBA pixels: equal for images with equal pixels however they are encoded
+* (filters, compression, interlacing, color type), unlike `PNGDecoder::getContentHash`, which needs no decoding.
+*/
+class PixelHashReducer : public RowReducer {
+public:
+    void begin(uint32_t width, uint32_t height) override;
+    void reduce(uint32_t row, const unsigned char* rgba, uint32_t width) override;
+
+    uint64_t digest() const;
+
+private:
+    utils::XXHash64 m_hash;
+};
+
+} // namespace png_decoder::reducer
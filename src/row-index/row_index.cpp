@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "row_index.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder::row_index {
+
+namespace {
+
+/*
+* Sidecar file layout (big-endian):
+*   8 bytes magic, uint32 version,
+*   uint32 width, uint32 height, uint8 bit depth, uint8 color type,
+*   uint64 IDAT data size, uint32 IDAT data crc32, uint32 rows per checkpoint, uint32 checkpoints count,
+*   for each checkpoint:
+*     uint32 row, uint64 input offset, uint8 bits,
+*     uint32 size + window bytes, uint32 size + row prefix bytes, uint32 size + previous scanline bytes
+*/
+constexpr char MAGIC[8] = {'P', 'N', 'G', 'R', 'I', 'D', 'X', '\n'};
+constexpr uint32_t VERSION = 1;
+
+// a checkpoint never holds more than the zlib window or a single scanline
+constexpr uint32_t MAX_BLOB_SIZE = 1U << 30;
+
+
+template <class T>
+void writeBigEndian(std::ostream& stream, T value) {
+    unsigned char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bytes[i] = (value >> (8 * (sizeof(T) - 1 - i))) & 0xFF;
+    }
+    stream.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+template <class T>
+T readBigEndian(std::istream& stream) {
+    unsigned char bytes[sizeof(T)];
+    if (!stream.read(reinterpret_cast<char*>(bytes), sizeof(T))) {
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Truncated row index"));
+    }
+
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+void writeBlob(std::ostream& stream, const std::vector<unsigned char>& bytes) {
+    writeBigEndian<uint32_t>(stream, bytes.size());
+    stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+std::vector<unsigned char> readBlob(std::istream& stream) {
+    const uint32_t size = readBigEndian<uint32_t>(stream);
+    if (size > MAX_BLOB_SIZE) {
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Invalid row index entry size"));
+    }
+
+    std::vector<unsigned char> bytes(size);
+    if (!stream.read(reinterpret_cast<char*>(bytes.data()), size)) {
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Truncated row index"));
+    }
+    return bytes;
+}
+
+} // namespace
+
+
+const Checkpoint& RowIndex::nearestCheckpoint(uint32_t row) const {
+    auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), row, [](uint32_t value, const Checkpoint& checkpoint) {
+        return value < checkpoint.row;
+    });
+
+    if (it == checkpoints.begin()) {
+        throw exceptions::DecodingException(PNG_DECODER_ERROR_MESSAGE("Row index has no checkpoint before row " + std::to_string(row)));
+    }
+    return *std::prev(it);
+}
+
+
+void RowIndex::save(std::ostream& stream) const {
+    stream.write(MAGIC, sizeof(MAGIC));
+    writeBigEndian<uint32_t>(stream, VERSION);
+
+    writeBigEndian<uint32_t>(stream, width);
+    writeBigEndian<uint32_t>(stream, height);
+    writeBigEndian<uint8_t>(stream, bitDepth);
+    writeBigEndian<uint8_t>(stream, colorType);
+    writeBigEndian<uint64_t>(stream, dataSize);
+    writeBigEndian<uint32_t>(stream, dataCrc);
+    writeBigEndian<uint32_t>(stream, rowsPerCheckpoint);
+    writeBigEndian<uint32_t>(stream, checkpoints.size());
+
+    for (const auto& checkpoint : checkpoints) {
+        writeBigEndian<uint32_t>(stream, checkpoint.row);
+        writeBigEndian<uint64_t>(stream, checkpoint.point.inputOffset);
+        writeBigEndian<uint8_t>(stream, checkpoint.point.bits);
+        writeBlob(stream, checkpoint.point.window);
+        writeBlob(stream, checkpoint.rowPrefix);
+        writeBlob(stream, checkpoint.previousScanline);
+    }
+
+    if (!stream) {
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Cannot write row index"));
+    }
+}
+
+
+RowIndex RowIndex::load(std::istream& stream) {
+    char magic[sizeof(MAGIC)];
+    if (!stream.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Invalid row index signature"));
+    }
+
+    const uint32_t version = readBigEndian<uint32_t>(stream);
+    if (version != VERSION) {
+        throw exceptions::InvalidStreamException(
+            PNG_DECODER_ERROR_MESSAGE("Unsupported row index version " + std::to_string(version)));
+    }
+
+    RowIndex index{};
+    index.width = readBigEndian<uint32_t>(stream);
+    index.height = readBigEndian<uint32_t>(stream);
+    index.bitDepth = readBigEndian<uint8_t>(stream);
+    index.colorType = readBigEndian<uint8_t>(stream);
+    index.dataSize = readBigEndian<uint64_t>(stream);
+    index.dataCrc = readBigEndian<uint32_t>(stream);
+    index.rowsPerCheckpoint = readBigEndian<uint32_t>(stream);
+
+    const uint32_t count = readBigEndian<uint32_t>(stream);
+    for (uint32_t i = 0; i < count; ++i) {
+        Checkpoint checkpoint{};
+        checkpoint.row = readBigEndian<uint32_t>(stream);
+        checkpoint.point.inputOffset = readBigEndian<uint64_t>(stream);
+        checkpoint.point.bits = readBigEndian<uint8_t>(stream);
+        checkpoint.point.window = readBlob(stream);
+        checkpoint.rowPrefix = readBlob(stream);
+        checkpoint.previousScanline = readBlob(stream);
+
+        if (checkpoint.point.bits > inflate::Inflate::MAX_ACCESS_POINT_BITS ||
+                checkpoint.point.window.size() > inflate::Inflate::WINDOW_SIZE) {
+            throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Invalid row index access point"));
+        }
+
+        if (!index.checkpoints.empty() && index.checkpoints.back().row > checkpoint.row) {
+            throw exceptions::InvalidStreamException(PNG_DECODER_ERROR_MESSAGE("Row index checkpoints are not sorted"));
+        }
+        index.checkpoints.push_back(std::move(checkpoint));
+    }
+
+    return index;
+}
+
+} // namespace png_decoder::row_index
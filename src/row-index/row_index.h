@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "inflate/inflate.h"
+
+
+namespace png_decoder::row_index {
+
+/*
+* Everything needed to resume decoding a non-interlaced image in the middle of its IDAT stream:
+* the inflate access point, bytes of the row that were inflated before the access point, and
+* the defiltered previous scanline that the filters of `row` refer to.
+*/
+struct Checkpoint {
+    // row in progress at the access point
+    uint32_t row = 0;
+    inflate::Inflate::AccessPoint point;
+    // filtered bytes (including filter method byte) of `row` inflated before the access point
+    std::vector<unsigned char> rowPrefix;
+    // defiltered scanline of `row - 1`, empty for the first row
+    std::vector<unsigned char> previousScanline;
+};
+
+
+/*
+* Random access index of an image built by `PNGDecoder::buildRowIndex` in a single pass over the inflate stream.
+* Checkpoints are taken at deflate block boundaries, at least `rowsPerCheckpoint` rows apart, sorted by row.
+* The index can be saved into a sidecar file and used later by `PNGDecoder::decodeRows`.
+*/
+struct RowIndex {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t bitDepth = 0;
+    uint8_t colorType = 0;
+    // size and crc32 of the concatenated IDAT data the index was built for
+    uint64_t dataSize = 0;
+    uint32_t dataCrc = 0;
+    uint32_t rowsPerCheckpoint = 0;
+    std::vector<Checkpoint> checkpoints;
+
+    /* returns the last checkpoint at or before `row` */
+    const Checkpoint& nearestCheckpoint(uint32_t row) const;
+
+    void save(std::ostream& stream) const;
+    static RowIndex load(std::istream& stream);
+};
+
+} // namespace png_decoder::row_index
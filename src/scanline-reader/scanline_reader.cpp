@@ -1,7 +1,10 @@
 #include <memory>
+#include <algorithm>
+#include <string>
 
 #include "scanline_reader.h"
 #include "strategy/strategy.h"
+#include "exceptions/exceptions.h"
 
 
 namespace png_decoder::scanline_reader {
@@ -18,7 +21,8 @@ ScanlineReader::ScanlineReader(
     , m_palette(std::move(palette))
     , m_data{data}
     , m_row{0}
-    , m_previousScanline{createEmptyScanline(width)}
+    , m_scanline{}
+    , m_previousScanline{}
     , m_defilters{}
     , m_strategy{PixelStrategy::create(colorType, bitDepth, m_palette)}
     {
@@ -26,6 +30,10 @@ ScanlineReader::ScanlineReader(
         m_defilters.push_back(std::make_unique<defilter::Up>());
         m_defilters.push_back(std::make_unique<defilter::Average>());
         m_defilters.push_back(std::make_unique<defilter::Paeth>());
+
+        // scanline size depends on the strategy, so the buffers cannot be created in the initializer list
+        m_scanline = createEmptyScanline(getScanlineSize());
+        m_previousScanline = createEmptyScanline(getScanlineSize());
     }
 
 
@@ -35,37 +43,156 @@ bool ScanlineReader::hasNext() const {
 
 
 std::vector<RGB> ScanlineReader::read() {
-    // reading filter method
-    const uint32_t scanlineOffset = getScanlineOffset();
-    Scanline scanline{};
-    std::memcpy(&scanline.filterMethod, &m_data[scanlineOffset], sizeof(scanline.filterMethod));
+    std::vector<RGB> pixels;
+    read(pixels);
+    return pixels;
+}
+
+
+void ScanlineReader::read(std::vector<RGB>& pixels) {
+    readFrom(&m_data[getScanlineOffset()], pixels);
+}
+
 
-    // reading data bytes into scanline
-    const uint32_t scanlineSize = getScanlineSize();
-    scanline.data.resize(scanlineSize);
-    std::memcpy(scanline.data.data(), &m_data[scanlineOffset + sizeof(scanline.filterMethod)], scanlineSize);
+std::vector<RGB> ScanlineReader::readFrom(const unsigned char* bytes) {
+    std::vector<RGB> pixels;
+    readFrom(bytes, pixels);
+    return pixels;
+}
+
+
+void ScanlineReader::readFrom(const unsigned char* bytes, std::vector<RGB>& pixels) {
+    const Scanline& scanline = defilterFrom(bytes);
+
+    // no-op for a buffer reused between rows of the same width
+    pixels.resize(m_width);
+    for (size_t i = 0; i < m_width; ++i) {
+        pixels[i] = m_strategy->pixelAt(scanline, i);
+    }
+}
+
+
+void ScanlineReader::readPackedFrom(const unsigned char* bytes, const PixelFormat& format, unsigned char* out) {
+    const Scanline& scanline = defilterFrom(bytes);
+    m_strategy->packRow(scanline, m_width, format, out);
+}
+
+
+const Scanline& ScanlineReader::defilterFrom(const unsigned char* bytes) {
+    // reading filter method and data bytes into the spare buffer, its size never changes
+    m_scanline.filterMethod = bytes[0];
+    if (!isFilterMethodValid(m_scanline.filterMethod)) {
+        throw exceptions::DecodingException(PNG_DECODER_ERROR_MESSAGE(
+            "Invalid filter type " + std::to_string(m_scanline.filterMethod) + " of row " + std::to_string(m_row)));
+    }
+    std::memcpy(m_scanline.data.data(), bytes + sizeof(m_scanline.filterMethod), m_scanline.data.size());
 
     // defiltering scanline
     const uint32_t bpp = m_strategy->bpp();
     for (const auto& defilter : m_defilters) {
-        if (defilter->applicable(scanline)) {
-            defilter->apply(scanline, m_previousScanline, bpp);
+        if (defilter->applicable(m_scanline)) {
+            defilter->apply(m_scanline, m_previousScanline, bpp);
         }
     }
 
-    std::vector<RGB> pixels;
-
-   for (size_t i = 0; i < m_width; ++i) {
-        RGB pixel = m_strategy->pixelAt(scanline, i);
-        pixels.push_back(pixel);
-   }
-
     // getting to the next row
     ++m_row;
-    // updating previous scanline
-    m_previousScanline = scanline;
+    // defiltered scanline becomes the previous one, the old previous scanline is overwritten by the next row
+    std::swap(m_scanline, m_previousScanline);
 
-    return pixels;
+    return m_previousScanline;
+}
+
+
+void ScanlineReader::defilterInPlace(unsigned char* bytes) {
+    const Scanline& scanline = defilterFrom(bytes);
+    bytes[0] = FILTER_METHOD_NONE;
+    std::memcpy(bytes + sizeof(scanline.filterMethod), scanline.data.data(), scanline.data.size());
+}
+
+
+bool ScanlineReader::isFilterMethodValid(uint8_t filterMethod) noexcept {
+    return filterMethod <= MAX_FILTER_METHOD;
+}
+
+
+uint32_t ScanlineReader::getRow() const {
+    return m_row;
+}
+
+
+const Scanline& ScanlineReader::getPreviousScanline() const {
+    return m_previousScanline;
+}
+
+
+void ScanlineReader::restore(uint32_t row, const std::vector<unsigned char>& previousScanline) {
+    tryRestore(row, previousScanline).value();
+}
+
+
+Expected<void> ScanlineReader::tryRestore(uint32_t row, const std::vector<unsigned char>& previousScanline) {
+    if (!previousScanline.empty() && previousScanline.size() != m_previousScanline.data.size()) {
+        return DecodeError{DecodeErrorCode::InvalidRowCheckpoint, 0,
+                           {previousScanline.size(), m_previousScanline.data.size()}};
+    }
+
+    m_row = row;
+    if (previousScanline.empty()) {
+        std::fill(m_previousScanline.data.begin(), m_previousScanline.data.end(), 0);
+    }
+    else {
+        std::copy(previousScanline.begin(), previousScanline.end(), m_previousScanline.data.begin());
+    }
+    return {};
+}
+
+
+// ScanlineAssembler
+ScanlineAssembler::ScanlineAssembler(size_t scanlineSize)
+    : m_scanlineSize{1 + scanlineSize}
+    , m_pending{}
+    {
+        m_pending.reserve(m_scanlineSize);
+    }
+
+
+bool ScanlineAssembler::feed(const unsigned char* buffer, size_t size, const ScanlineCallback& onScanline) {
+    while (size > 0) {
+        // whole scanline is available in the buffer, no need to copy it
+        if (m_pending.empty() && size >= m_scanlineSize) {
+            if (!onScanline(buffer)) {
+                return false;
+            }
+            buffer += m_scanlineSize;
+            size -= m_scanlineSize;
+            continue;
+        }
+
+        size_t count = std::min(size, m_scanlineSize - m_pending.size());
+        m_pending.insert(m_pending.end(), buffer, buffer + count);
+        buffer += count;
+        size -= count;
+
+        if (m_pending.size() == m_scanlineSize) {
+            bool proceed = onScanline(m_pending.data());
+            m_pending.clear();
+            if (!proceed) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void ScanlineAssembler::prefill(const std::vector<unsigned char>& bytes) {
+    m_pending = bytes;
+}
+
+
+const std::vector<unsigned char>& ScanlineAssembler::pending() const {
+    return m_pending;
 }
 
 
@@ -76,15 +203,16 @@ uint32_t ScanlineReader::getScanlineOffset() const {
 
 
 uint32_t ScanlineReader::getScanlineSize() const {
-    uint32_t sizeBits = m_strategy->samplesCount() * m_strategy->sampleSizeBits() * m_width;
-    uint32_t sizeBytes = (sizeBits / 8) + (sizeBits % 8 != 0);
+    // fits into 32 bits for any width accepted by IHDR validation
+    uint64_t sizeBits = static_cast<uint64_t>(m_strategy->samplesCount()) * m_strategy->sampleSizeBits() * m_width;
+    uint64_t sizeBytes = (sizeBits / 8) + (sizeBits % 8 != 0);
     return sizeBytes;
 }
 
 
-Scanline ScanlineReader::createEmptyScanline(uint32_t width) {
+Scanline ScanlineReader::createEmptyScanline(uint32_t size) {
     Scanline scanline{};
-    scanline.data.resize(width, 0);
+    scanline.data.resize(size, 0);
     return scanline;
 }
 
@@ -5,9 +5,11 @@
 #include <cstring>
 #include <cassert>
 #include <memory>
+#include <functional>
 
 // misc
 #include "misc/structs.h"
+#include "misc/expected.h"
 // defilter
 #include "defilter/defilter.h"
 // strategy
@@ -30,13 +32,37 @@ public:
 
     bool hasNext() const;
     std::vector<RGB> read();
+    /* same as `read`, reusing memory of `pixels` */
+    void read(std::vector<RGB>& pixels);
+    /* defilters the next scanline taken from `bytes` (filter method byte followed by scanline data) */
+    std::vector<RGB> readFrom(const unsigned char* bytes);
+    void readFrom(const unsigned char* bytes, std::vector<RGB>& pixels);
+    /* same as `readFrom`, converting the scanline straight into packed pixels of the given format */
+    void readPackedFrom(const unsigned char* bytes, const PixelFormat& format, unsigned char* out);
+    /* same as `readFrom` without converting scanline into pixels */
+    const Scanline& defilterFrom(const unsigned char* bytes);
+    /*
+    * same as `defilterFrom`, writing the defiltered scanline back over `bytes` with filter method None,
+    * so that it can be read again by any reader, regardless of the previous scanline
+    */
+    void defilterInPlace(unsigned char* bytes);
     uint32_t getScanlineSize() const;
+    /* `defilterFrom` throws on other filter methods */
+    static bool isFilterMethodValid(uint8_t filterMethod) noexcept;
+
+    /* index of the next row to read */
+    uint32_t getRow() const;
+    const Scanline& getPreviousScanline() const;
+    /* continues reading from `row` as if the defiltered scanline of `row - 1` was `previousScanline` */
+    void restore(uint32_t row, const std::vector<unsigned char>& previousScanline);
+    /* same as `restore`, returning an error instead of throwing if `previousScanline` has a wrong size */
+    Expected<void> tryRestore(uint32_t row, const std::vector<unsigned char>& previousScanline);
 
 private:
     uint32_t getScanlineOffset() const;
 
 private:
-    static Scanline createEmptyScanline(uint32_t width);
+    static Scanline createEmptyScanline(uint32_t size);
 
 private:
     static constexpr uint8_t PIXEL_GRAYSCALE_COLOR_TYPE = 0;
@@ -44,6 +70,9 @@ private:
     static constexpr uint8_t PIXEL_PALETTE_INDEX_COLOR_TYPE = 3;
     static constexpr uint8_t PIXEL_GRAYSCALE_ALPHA_COLOR_TYPE = 4;
     static constexpr uint8_t PIXEL_RGB_ALPHA_COLOR_TYPE = 6;
+    static constexpr uint8_t FILTER_METHOD_NONE = 0;
+    // Paeth
+    static constexpr uint8_t MAX_FILTER_METHOD = 4;
 
 private:
     uint32_t m_width;
@@ -51,10 +80,38 @@ private:
     PLTE m_palette;
     const std::vector<unsigned char>& m_data;
     uint32_t m_row;
+    /*
+    * Two row buffers of the scanline size allocated once: the next scanline is copied and defiltered
+    * in `m_scanline`, then the buffers are swapped, so no memory is allocated per row.
+    */
+    Scanline m_scanline;
     Scanline m_previousScanline;
     std::vector<std::unique_ptr<defilter::Defilter>> m_defilters;
     std::unique_ptr<PixelStrategy> m_strategy;
 };
 
 
+/*
+* Splits a stream of inflated bytes into filtered scanlines (filter method byte followed by scanline data).
+* Bytes of a scanline spanning several blocks of the stream are accumulated until the scanline is complete.
+*/
+class ScanlineAssembler {
+public:
+    /* receives complete filtered scanline, returning false stops feeding */
+    using ScanlineCallback = std::function<bool(const unsigned char* bytes)>;
+
+    explicit ScanlineAssembler(size_t scanlineSize);
+
+    /* returns false if stopped by the callback */
+    bool feed(const unsigned char* buffer, size_t size, const ScanlineCallback& onScanline);
+    /* bytes of the incomplete scanline received so far */
+    void prefill(const std::vector<unsigned char>& bytes);
+    const std::vector<unsigned char>& pending() const;
+
+private:
+    size_t m_scanlineSize;
+    std::vector<unsigned char> m_pending;
+};
+
+
 } // namespace png_decoder::scanline_reader
@@ -5,10 +5,116 @@
 #include "strategy.h"
 #include "exceptions/exceptions.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 
 namespace png_decoder::scanline_reader {
 
+namespace {
+
+#if defined(__SSE2__)
+/*
+* Converts four RGBA pixels into the requested format.
+* Premultiplication works on 16-bit lanes: round(c * a / 255) == (t + (t >> 8)) >> 8, where t = c * a + 128.
+*/
+__m128i convertPixels(__m128i rgba, const PixelFormat& format) {
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    if (format.alphaMode == AlphaMode::Premultiplied) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i half = _mm_set1_epi16(128);
+
+        auto premultiplyPair = [&](__m128i pixels) {
+            // broadcasting alpha of each pixel over its four lanes
+            const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xFF), 0xFF);
+            const __m128i product = _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), half);
+            return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+        };
+
+        const __m128i low = premultiplyPair(_mm_unpacklo_epi8(rgba, zero));
+        const __m128i high = premultiplyPair(_mm_unpackhi_epi8(rgba, zero));
+        const __m128i premultiplied = _mm_packus_epi16(low, high);
+
+        // alpha itself is kept as is
+        rgba = _mm_or_si128(_mm_andnot_si128(alphaMask, premultiplied), _mm_and_si128(alphaMask, rgba));
+    }
+
+    // pixels are little-endian 32-bit lanes: R | G << 8 | B << 16 | A << 24
+    switch (format.channelOrder) {
+    case ChannelOrder::RGBA:
+        return rgba;
+    case ChannelOrder::BGRA: {
+        const __m128i greenAlpha = _mm_and_si128(rgba, _mm_set1_epi32(static_cast<int>(0xFF00FF00)));
+        const __m128i red = _mm_srli_epi32(_mm_slli_epi32(rgba, 24), 8);
+        const __m128i blue = _mm_srli_epi32(_mm_slli_epi32(rgba, 8), 24);
+        return _mm_or_si128(greenAlpha, _mm_or_si128(red, blue));
+    }
+    case ChannelOrder::ARGB:
+        return _mm_or_si128(_mm_slli_epi32(rgba, 8), _mm_srli_epi32(rgba, 24));
+    }
+    return rgba;
+}
+#endif
+
+
+void packRGBAPixels(const unsigned char* rgba, size_t count, const PixelFormat& format, unsigned char* out) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 4 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i), convertPixels(pixels, format));
+    }
+#endif
+    for (; i < count; ++i) {
+        const unsigned char* pixel = rgba + 4 * i;
+        packPixel(pixel[0], pixel[1], pixel[2], pixel[3], format, out + 4 * i);
+    }
+}
+
+
+void packGrayscaleAlphaPixels(const unsigned char* grayscaleAlpha, size_t count, const PixelFormat& format, unsigned char* out) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        // 32-bit lanes of G | A << 8 expanded into G | G << 8 | G << 16 | A << 24
+        const __m128i pairs = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(grayscaleAlpha + 2 * i));
+        const __m128i lanes = _mm_unpacklo_epi16(pairs, _mm_setzero_si128());
+        const __m128i gray = _mm_and_si128(lanes, _mm_set1_epi32(0xFF));
+        const __m128i alpha = _mm_slli_epi32(_mm_srli_epi32(lanes, 8), 24);
+        const __m128i rgba = _mm_or_si128(
+            _mm_or_si128(gray, _mm_slli_epi32(gray, 8)), _mm_or_si128(_mm_slli_epi32(gray, 16), alpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i), convertPixels(rgba, format));
+    }
+#endif
+    for (; i < count; ++i) {
+        const unsigned char* pixel = grayscaleAlpha + 2 * i;
+        packPixel(pixel[0], pixel[0], pixel[0], pixel[1], format, out + 4 * i);
+    }
+}
+
+
+// splits `BITS`-bit indices into bytes, the leftmost pixel of a byte is in its high-order bits
+template <uint32_t BITS>
+void unpackIndices(const unsigned char* data, size_t count, unsigned char* out) {
+    constexpr uint32_t PER_BYTE = 8 / BITS;
+    constexpr uint8_t MASK = (1 << BITS) - 1;
+
+    size_t i = 0;
+    for (; i + PER_BYTE <= count; i += PER_BYTE, ++data) {
+        for (uint32_t j = 0; j < PER_BYTE; ++j) {
+            out[i + j] = (*data >> (8 - BITS * (j + 1))) & MASK;
+        }
+    }
+    for (uint32_t j = 0; i < count; ++i, ++j) {
+        out[i] = (*data >> (8 - BITS * (j + 1))) & MASK;
+    }
+}
+
+} // namespace
+
 
 PixelStrategy::PixelStrategy(uint8_t bitDepth, PLTE plte)
     : m_bitDepth{bitDepth}
@@ -25,6 +131,13 @@ uint32_t PixelStrategy::sampleSizeBits() const noexcept {
     return m_bitDepth;
 }
 
+void PixelStrategy::packRow(const Scanline& scanline, size_t width, const PixelFormat& format, unsigned char* out) const {
+    for (size_t i = 0; i < width; ++i) {
+        const RGB pixel = pixelAt(scanline, i);
+        packPixel(pixel.r, pixel.g, pixel.b, pixel.a, format, out + PACKED_PIXEL_SIZE * i);
+    }
+}
+
 
 std::unique_ptr<PixelStrategy> PixelStrategy::create(uint8_t colorType, uint8_t bitDepth, PLTE plte) {
     if (colorType == PIXEL_GRAYSCALE_COLOR_TYPE) {
@@ -125,7 +238,17 @@ RGB PixelRGBStrategy::pixelAt(const Scanline& scanline, size_t index) const {
 
 
 // PixelPaletteIndexStrategy
-PixelPaletteIndexStrategy::PixelPaletteIndexStrategy(uint8_t bitDepth, PLTE plte) : PixelStrategy(bitDepth, std::move(plte)) {}
+PixelPaletteIndexStrategy::PixelPaletteIndexStrategy(uint8_t bitDepth, PLTE plte)
+    : PixelStrategy(bitDepth, std::move(plte))
+    , m_colors{}
+    {
+        m_colors.fill(RGB{0, 0, 0, 255});
+        const size_t count = std::min(m_plte.palette.size(), m_colors.size());
+        for (size_t i = 0; i < count; ++i) {
+            const PLTE::rgb& color = m_plte.palette[i];
+            m_colors[i] = RGB{color.red, color.green, color.blue, 255};
+        }
+    }
 
 uint32_t PixelPaletteIndexStrategy::samplesCount() const noexcept {
     return 1;
@@ -134,17 +257,22 @@ uint32_t PixelPaletteIndexStrategy::samplesCount() const noexcept {
 RGB PixelPaletteIndexStrategy::pixelAt(const Scanline& scanline, size_t index) const {
     // since samples count is one index is already correct
     uint8_t paletteIndex = getPixelBits(scanline, index, sampleSizeBits());
-    assert(paletteIndex < m_plte.palette.size());
-
-    PLTE::rgb color = m_plte.palette[paletteIndex];
-    RGB pixel{};
+    return m_colors[paletteIndex];
+}
 
-    pixel.r = color.red;
-    pixel.g = color.green;
-    pixel.b = color.blue;
-    pixel.a = 255;
+void PixelPaletteIndexStrategy::packRow(const Scanline& scanline, size_t width, const PixelFormat& format, unsigned char* out) const {
+    if (!isPaletteIndex(format)) {
+        PixelStrategy::packRow(scanline, width, format, out);
+        return;
+    }
 
-    return pixel;
+    const unsigned char* data = scanline.data.data();
+    switch (m_bitDepth) {
+    case 1: unpackIndices<1>(data, width, out); break;
+    case 2: unpackIndices<2>(data, width, out); break;
+    case 4: unpackIndices<4>(data, width, out); break;
+    default: std::memcpy(out, data, width); break;
+    }
 }
 
 
@@ -155,6 +283,14 @@ uint32_t PixelGrayscaleAlphaStrategy::samplesCount() const noexcept {
     return 2;
 }
 
+void PixelGrayscaleAlphaStrategy::packRow(const Scanline& scanline, size_t width, const PixelFormat& format, unsigned char* out) const {
+    if (m_bitDepth != 8) {
+        PixelStrategy::packRow(scanline, width, format, out);
+        return;
+    }
+    packGrayscaleAlphaPixels(scanline.data.data(), width, format, out);
+}
+
 RGB PixelGrayscaleAlphaStrategy::pixelAt(const Scanline& scanline, size_t index) const {
     RGB pixel{};
 
@@ -185,6 +321,14 @@ uint32_t PixelRGBAlphaStrategy::samplesCount() const noexcept {
     return 4;
 }
 
+void PixelRGBAlphaStrategy::packRow(const Scanline& scanline, size_t width, const PixelFormat& format, unsigned char* out) const {
+    if (m_bitDepth != 8) {
+        PixelStrategy::packRow(scanline, width, format, out);
+        return;
+    }
+    packRGBAPixels(scanline.data.data(), width, format, out);
+}
+
 RGB PixelRGBAlphaStrategy::pixelAt(const Scanline& scanline, size_t index) const {
     RGB pixel{};
 
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <array>
 #include <memory>
 
 #include "misc/structs.h"
+#include "misc/pixel_format.h"
 #include "image.h"
 
 
@@ -19,6 +21,8 @@ public:
 
     virtual RGB pixelAt(const Scanline& scanline, size_t index) const = 0;
     virtual uint32_t samplesCount() const noexcept = 0;
+    /* converts `width` pixels of the scanline into packed pixels of the given format (4 bytes per pixel) */
+    virtual void packRow(const Scanline& scanline, size_t width, const PixelFormat& format, unsigned char* out) const;
 
 public:
     static std::unique_ptr<PixelStrategy> create(uint8_t colorType, uint8_t bitDepth, PLTE plte);
@@ -71,6 +75,15 @@ public:
     PixelPaletteIndexStrategy(uint8_t bitDepth, PLTE plte);
     RGB pixelAt(const Scanline& scanline, size_t index) const override;
     uint32_t samplesCount() const noexcept override;
+    /* also unpacks indices into one byte per pixel for `SampleType::PaletteIndex` */
+    void packRow(const Scanline& scanline, size_t width, const PixelFormat& format, unsigned char* out) const override;
+
+private:
+    /*
+    * Colors of all 256 possible indices: indices not covered by the palette are opaque black (as in libpng),
+    * so lookups of untrusted indices need no range check.
+    */
+    std::array<RGB, 256> m_colors;
 };
 
 
@@ -80,6 +93,7 @@ public:
     PixelGrayscaleAlphaStrategy(uint8_t bitDepth, PLTE plte);
     RGB pixelAt(const Scanline& scanline, size_t index) const override;
     uint32_t samplesCount() const noexcept override;
+    void packRow(const Scanline& scanline, size_t width, const PixelFormat& format, unsigned char* out) const override;
 };
 
 
@@ -89,6 +103,7 @@ public:
     PixelRGBAlphaStrategy(uint8_t bitDepth, PLTE plte);
     RGB pixelAt(const Scanline& scanline, size_t index) const override;
     uint32_t samplesCount() const noexcept override;
+    void packRow(const Scanline& scanline, size_t width, const PixelFormat& format, unsigned char* out) const override;
 };
 
 
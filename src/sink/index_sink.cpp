@@ -0,0 +1,121 @@
+#include <cstring>
+
+#include "index_sink.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder::sink {
+
+namespace {
+
+// joins one-byte indices into `BITS`-bit ones, the leftmost pixel of a byte goes into its high-order bits
+template <uint32_t BITS>
+void packIndices(const unsigned char* indices, size_t count, unsigned char* out) {
+    constexpr uint32_t PER_BYTE = 8 / BITS;
+    constexpr uint8_t MASK = (1 << BITS) - 1;
+
+    size_t i = 0;
+    for (; i + PER_BYTE <= count; i += PER_BYTE, ++out) {
+        uint8_t byte = 0;
+        for (uint32_t j = 0; j < PER_BYTE; ++j) {
+            byte |= (indices[i + j] & MASK) << (8 - BITS * (j + 1));
+        }
+        *out = byte;
+    }
+    if (i < count) {
+        // unused low-order bits of the last byte are zero
+        uint8_t byte = 0;
+        for (uint32_t j = 0; i < count; ++i, ++j) {
+            byte |= (indices[i] & MASK) << (8 - BITS * (j + 1));
+        }
+        *out = byte;
+    }
+}
+
+} // namespace
+
+
+// IndexedImage
+uint8_t IndexedImage::indexAt(uint32_t row, uint32_t col) const {
+    const unsigned char* data = indices.data() + row * stride;
+    if (bitDepth == 8) {
+        return data[col];
+    }
+    const uint32_t perByte = 8 / bitDepth;
+    const uint32_t shift = 8 - bitDepth * (col % perByte + 1);
+    return (data[col / perByte] >> shift) & ((1 << bitDepth) - 1);
+}
+
+uint8_t IndexedImage::alphaAt(uint8_t index) const {
+    return (index < alpha.size()) ? alpha[index] : 0xFF;
+}
+
+
+// IndexSink
+IndexSink::IndexSink(IndexedImage& image, IndexLayout layout, uint8_t bitDepth, Orientation orientation)
+    : m_image{image}
+    , m_layout{layout}
+    , m_bitDepth{bitDepth}
+    , m_writer{orientation} {}
+
+void IndexSink::begin(uint32_t width, uint32_t height) {
+    if (m_layout == IndexLayout::BitPacked) {
+        m_image.width = width;
+        m_image.height = height;
+        m_image.bitDepth = m_bitDepth;
+        m_image.stride = (static_cast<size_t>(width) * m_bitDepth + 7) / 8;
+        m_image.indices.assign(m_image.stride * height, 0);
+        return;
+    }
+
+    const Orientation orientation = m_writer.orientation();
+    m_image.width = orientedWidth(orientation, width, height);
+    m_image.height = orientedHeight(orientation, width, height);
+    m_image.bitDepth = 8;
+    m_image.stride = m_image.width;
+    m_image.indices.resize(m_image.stride * m_image.height);
+    m_writer.begin(m_image.indices.data(), m_image.stride, width, height, sizeof(uint8_t));
+}
+
+void IndexSink::write([[maybe_unused]] uint32_t row, [[maybe_unused]] const std::vector<RGB>& pixels) {
+    throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("Index sink requires palette index packed rows"));
+}
+
+void IndexSink::end() {}
+
+bool IndexSink::acceptsConcurrentRows() const {
+    // rows are disjoint parts of the indices, unless the writer gathers them into bands
+    return m_layout == IndexLayout::BitPacked || m_writer.acceptsConcurrentRows();
+}
+
+bool IndexSink::acceptsPackedRows() const {
+    return true;
+}
+
+void IndexSink::setPackedFormat(const PixelFormat& format) {
+    if (!isPaletteIndex(format)) {
+        throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("Index sink requires palette index packed rows"));
+    }
+}
+
+unsigned char* IndexSink::packedRowTarget(uint32_t row) {
+    // bit-packed rows are joined from the bytes of the decoder's row buffer
+    return (m_layout == IndexLayout::Bytes) ? m_writer.rowTarget(row) : nullptr;
+}
+
+void IndexSink::writePacked(uint32_t row, const unsigned char* pixels) {
+    if (m_layout == IndexLayout::Bytes) {
+        m_writer.writeRow(row, pixels);
+        return;
+    }
+
+    unsigned char* out = m_image.indices.data() + row * m_image.stride;
+    switch (m_bitDepth) {
+    case 1: packIndices<1>(pixels, m_image.width, out); break;
+    case 2: packIndices<2>(pixels, m_image.width, out); break;
+    case 4: packIndices<4>(pixels, m_image.width, out); break;
+    default: std::memcpy(out, pixels, m_image.width); break;
+    }
+}
+
+} // namespace png_decoder::sink
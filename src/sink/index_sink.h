@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sink.h"
+#include "misc/structs.h"
+#include "misc/orientation.h"
+#include "orientation/oriented_writer.h"
+
+
+namespace png_decoder::sink {
+
+enum class IndexLayout : uint8_t {
+    // one byte per pixel
+    Bytes = 0,
+    // indices of the bit depth of the image, the leftmost pixel in the high-order bits (as in PNG rows)
+    BitPacked,
+};
+
+
+// palette image decoded without expanding its indices into colors, see `PNGDecoder::createIndexedImage`
+struct IndexedImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // bits per index in `indices`: 8 for `IndexLayout::Bytes`, the bit depth of the image for `IndexLayout::BitPacked`
+    uint8_t bitDepth = 8;
+    // bytes between row starts
+    size_t stride = 0;
+    std::vector<PLTE::rgb> palette;
+    // alpha of the first palette entries (tRNS chunk), the entries past its end are opaque
+    std::vector<uint8_t> alpha;
+    std::vector<unsigned char> indices;
+
+    uint8_t indexAt(uint32_t row, uint32_t col) const;
+    uint8_t alphaAt(uint8_t index) const;
+};
+
+
+/*
+* Fills an `IndexedImage` from packed rows of `SampleType::PaletteIndex`. Bytes are written upright
+* for the given orientation; bit-packed rows, like the PNG rows they mirror, keep the stored orientation.
+* Fills neither the palette nor the alpha of the image.
+*/
+class IndexSink : public RowSink {
+public:
+    IndexSink(IndexedImage& image, IndexLayout layout, uint8_t bitDepth, Orientation orientation = Orientation::TopLeft);
+
+    void begin(uint32_t width, uint32_t height) override;
+    void write(uint32_t row, const std::vector<RGB>& pixels) override;
+    void end() override;
+
+    bool acceptsConcurrentRows() const override;
+    bool acceptsPackedRows() const override;
+    void setPackedFormat(const PixelFormat& format) override;
+    unsigned char* packedRowTarget(uint32_t row) override;
+    void writePacked(uint32_t row, const unsigned char* pixels) override;
+
+private:
+    IndexedImage& m_image;
+    IndexLayout m_layout;
+    uint8_t m_bitDepth;
+    orientation::OrientedWriter m_writer;
+};
+
+} // namespace png_decoder::sink
@@ -0,0 +1,85 @@
+#include "jpeg_sink.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder::sink {
+
+/*
+* Note: no objects with non-trivial destructors may live between `setjmp` and
+* the libjpeg calls it guards, since `longjmp` skips their destruction.
+*/
+
+JPEGSink::JPEGSink(FILE* file, int quality)
+    : m_file{file}
+    , m_quality{quality}
+    , m_info{}
+    , m_error{}
+    , m_row{}
+    {
+        m_info.err = jpeg_std_error(&m_error.base);
+        m_error.base.error_exit = &JPEGSink::onError;
+
+        if (setjmp(m_error.jump)) {
+            throwError();
+        }
+        jpeg_create_compress(&m_info);
+    }
+
+JPEGSink::~JPEGSink() {
+    jpeg_destroy_compress(&m_info);
+}
+
+
+void JPEGSink::begin(uint32_t width, uint32_t height) {
+    m_row.resize(COMPONENTS_COUNT * width);
+
+    if (setjmp(m_error.jump)) {
+        throwError();
+    }
+
+    jpeg_stdio_dest(&m_info, m_file);
+    m_info.image_width = width;
+    m_info.image_height = height;
+    m_info.input_components = COMPONENTS_COUNT;
+    m_info.in_color_space = JCS_RGB;
+
+    jpeg_set_defaults(&m_info);
+    jpeg_set_quality(&m_info, m_quality, TRUE);
+    jpeg_start_compress(&m_info, TRUE);
+}
+
+void JPEGSink::write([[maybe_unused]] uint32_t row, const std::vector<RGB>& pixels) {
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        m_row[COMPONENTS_COUNT * i] = pixels[i].r;
+        m_row[COMPONENTS_COUNT * i + 1] = pixels[i].g;
+        m_row[COMPONENTS_COUNT * i + 2] = pixels[i].b;
+    }
+
+    JSAMPROW rows[] = {m_row.data()};
+
+    if (setjmp(m_error.jump)) {
+        throwError();
+    }
+    jpeg_write_scanlines(&m_info, rows, 1);
+}
+
+void JPEGSink::end() {
+    if (setjmp(m_error.jump)) {
+        throwError();
+    }
+    jpeg_finish_compress(&m_info);
+}
+
+
+void JPEGSink::onError(j_common_ptr info) {
+    auto* error = reinterpret_cast<ErrorManager*>(info->err);
+    (*info->err->format_message)(info, error->message);
+    std::longjmp(error->jump, 1);
+}
+
+void JPEGSink::throwError() const {
+    throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("libjpeg: " + std::string(m_error.message)));
+}
+
+
+} // namespace png_decoder::sink
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <csetjmp>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <jpeglib.h>
+
+#include "sink.h"
+
+
+namespace png_decoder::sink {
+
+/*
+* Encodes rows with libjpeg's scanline API as soon as they are decoded.
+* Alpha channel is dropped. Only compiled when the library is built with PNG_DECODER_WITH_JPEG.
+*/
+class JPEGSink : public RowSink {
+public:
+    /* `file` must be opened in binary write mode and outlive the sink */
+    explicit JPEGSink(FILE* file, int quality = DEFAULT_QUALITY);
+    ~JPEGSink() override;
+
+    JPEGSink(const JPEGSink&) = delete;
+    JPEGSink& operator=(const JPEGSink&) = delete;
+
+    void begin(uint32_t width, uint32_t height) override;
+    void write(uint32_t row, const std::vector<RGB>& pixels) override;
+    void end() override;
+
+private:
+    /* libjpeg reports fatal errors via callback; jumping back lets the sink throw from C++ code */
+    struct ErrorManager {
+        jpeg_error_mgr base;
+        std::jmp_buf jump;
+        char message[JMSG_LENGTH_MAX];
+    };
+
+    static void onError(j_common_ptr info);
+    [[noreturn]] void throwError() const;
+
+private:
+    static constexpr int DEFAULT_QUALITY = 90;
+    static constexpr int COMPONENTS_COUNT = 3;
+
+private:
+    FILE* m_file;
+    int m_quality;
+    jpeg_compress_struct m_info;
+    ErrorManager m_error;
+    std::vector<JSAMPLE> m_row;
+};
+
+
+} // namespace png_decoder::sink
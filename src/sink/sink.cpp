@@ -0,0 +1,215 @@
+#include <string>
+
+#include "sink.h"
+#include "exceptions/exceptions.h"
+
+
+namespace png_decoder::sink {
+
+// RowSink
+bool RowSink::acceptsConcurrentRows() const {
+    return false;
+}
+
+bool RowSink::acceptsPackedRows() const {
+    return false;
+}
+
+void RowSink::setPackedFormat([[maybe_unused]] const PixelFormat& format) {}
+
+unsigned char* RowSink::packedRowTarget([[maybe_unused]] uint32_t row) {
+    return nullptr;
+}
+
+void RowSink::writePacked([[maybe_unused]] uint32_t row, [[maybe_unused]] const unsigned char* pixels) {
+    throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("Sink does not accept packed rows"));
+}
+
+
+// ImageSink
+ImageSink::ImageSink(Image& image, Orientation orientation) : m_image{image}, m_writer{orientation} {}
+
+void ImageSink::begin(uint32_t width, uint32_t height) {
+    const Orientation orientation = m_writer.orientation();
+    const uint32_t imageWidth = orientedWidth(orientation, width, height);
+    m_image.SetSize(orientedHeight(orientation, width, height), imageWidth);
+    // pixels of the image are contiguous rows of `RGB`
+    unsigned char* data = (width == 0 || height == 0) ? nullptr : reinterpret_cast<unsigned char*>(&m_image(0, 0));
+    m_writer.begin(data, sizeof(RGB) * imageWidth, width, height, sizeof(RGB));
+}
+
+void ImageSink::write(uint32_t row, const std::vector<RGB>& pixels) {
+    m_writer.writeRow(row, reinterpret_cast<const unsigned char*>(pixels.data()));
+}
+
+void ImageSink::end() {}
+
+bool ImageSink::acceptsConcurrentRows() const {
+    // rows are disjoint parts of the image allocated in `begin`, unless they are gathered into bands
+    return m_writer.acceptsConcurrentRows();
+}
+
+
+// StreamSink
+StreamSink::StreamSink(std::ostream& stream) : m_stream{stream}, m_row{} {}
+
+void StreamSink::end() {
+    if (!m_stream.flush()) {
+        throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("Cannot flush output stream"));
+    }
+}
+
+void StreamSink::writeBytes(const std::vector<unsigned char>& bytes) {
+    if (!m_stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size())) {
+        throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("Cannot write to output stream"));
+    }
+}
+
+
+// PPMSink
+PPMSink::PPMSink(std::ostream& stream) : StreamSink(stream) {}
+
+void PPMSink::begin(uint32_t width, uint32_t height) {
+    m_stream << "P6\n" << width << " " << height << "\n255\n";
+    m_row.resize(3 * width);
+}
+
+void PPMSink::write([[maybe_unused]] uint32_t row, const std::vector<RGB>& pixels) {
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        m_row[3 * i] = pixels[i].r;
+        m_row[3 * i + 1] = pixels[i].g;
+        m_row[3 * i + 2] = pixels[i].b;
+    }
+    writeBytes(m_row);
+}
+
+
+// PAMSink
+PAMSink::PAMSink(std::ostream& stream) : StreamSink(stream) {}
+
+void PAMSink::begin(uint32_t width, uint32_t height) {
+    m_stream << "P7\n"
+             << "WIDTH " << width << "\n"
+             << "HEIGHT " << height << "\n"
+             << "DEPTH 4\n"
+             << "MAXVAL 255\n"
+             << "TUPLTYPE RGB_ALPHA\n"
+             << "ENDHDR\n";
+    m_row.resize(4 * width);
+}
+
+void PAMSink::write([[maybe_unused]] uint32_t row, const std::vector<RGB>& pixels) {
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        m_row[4 * i] = pixels[i].r;
+        m_row[4 * i + 1] = pixels[i].g;
+        m_row[4 * i + 2] = pixels[i].b;
+        m_row[4 * i + 3] = pixels[i].a;
+    }
+    writeBytes(m_row);
+}
+
+
+// RawRGBASink
+RawRGBASink::RawRGBASink(std::ostream& stream) : StreamSink(stream), m_packedPixelSize{PACKED_PIXEL_SIZE} {}
+
+void RawRGBASink::begin(uint32_t width, [[maybe_unused]] uint32_t height) {
+    m_row.resize(4 * width);
+}
+
+void RawRGBASink::write([[maybe_unused]] uint32_t row, const std::vector<RGB>& pixels) {
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        m_row[4 * i] = pixels[i].r;
+        m_row[4 * i + 1] = pixels[i].g;
+        m_row[4 * i + 2] = pixels[i].b;
+        m_row[4 * i + 3] = pixels[i].a;
+    }
+    writeBytes(m_row);
+}
+
+bool RawRGBASink::acceptsPackedRows() const {
+    return true;
+}
+
+void RawRGBASink::setPackedFormat(const PixelFormat& format) {
+    m_packedPixelSize = packedPixelSize(format);
+}
+
+void RawRGBASink::writePacked([[maybe_unused]] uint32_t row, const unsigned char* pixels) {
+    // `m_row` holds 8-bit pixels
+    const size_t size = m_row.size() / PACKED_PIXEL_SIZE * m_packedPixelSize;
+    if (!m_stream.write(reinterpret_cast<const char*>(pixels), size)) {
+        throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("Cannot write to output stream"));
+    }
+}
+
+
+// BufferSink
+BufferSink::BufferSink(unsigned char* buffer, size_t size, size_t stride, Orientation orientation)
+    : m_buffer{buffer}
+    , m_size{size}
+    , m_stride{stride}
+    , m_rowCapacity{stride}
+    , m_requiredPixelSize{0}
+    , m_packedPixelSize{PACKED_PIXEL_SIZE}
+    , m_writer{orientation} {}
+
+BufferSink::BufferSink(const image_view::ImageView& view, Orientation orientation)
+    : m_buffer{view.data()}
+    , m_size{view.size()}
+    , m_stride{view.stride()}
+    , m_rowCapacity{view.width() * view.pixelSize()}
+    , m_requiredPixelSize{view.pixelSize()}
+    , m_packedPixelSize{view.pixelSize()}
+    , m_writer{orientation} {}
+
+void BufferSink::begin(uint32_t width, uint32_t height) {
+    const Orientation orientation = m_writer.orientation();
+    const uint32_t bufferWidth = orientedWidth(orientation, width, height);
+    const uint32_t bufferHeight = orientedHeight(orientation, width, height);
+    const size_t rowSize = m_packedPixelSize * static_cast<size_t>(bufferWidth);
+    const size_t required = (bufferHeight == 0) ? 0 : static_cast<size_t>(bufferHeight - 1) * m_stride + rowSize;
+    if (rowSize > m_rowCapacity || required > m_size) {
+        throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE(
+            "Buffer of " + std::to_string(m_size) + " bytes with stride " + std::to_string(m_stride) +
+            " cannot hold " + std::to_string(bufferWidth) + "x" + std::to_string(bufferHeight) + " image"));
+    }
+    m_writer.begin(m_buffer, m_stride, width, height, m_packedPixelSize);
+}
+
+void BufferSink::write(uint32_t row, const std::vector<RGB>& pixels) {
+    unsigned char* target = m_writer.rowTarget(row);
+    packPixels(pixels, PixelFormat{}, target);
+    m_writer.writeRow(row, target);
+}
+
+void BufferSink::end() {}
+
+bool BufferSink::acceptsConcurrentRows() const {
+    // rows are disjoint parts of the buffer, unless they are gathered into bands
+    return m_writer.acceptsConcurrentRows();
+}
+
+bool BufferSink::acceptsPackedRows() const {
+    return true;
+}
+
+void BufferSink::setPackedFormat(const PixelFormat& format) {
+    m_packedPixelSize = packedPixelSize(format);
+    if (m_requiredPixelSize != 0 && m_packedPixelSize != m_requiredPixelSize) {
+        throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE(
+            "View of " + std::to_string(m_requiredPixelSize) + "-byte pixels cannot hold " +
+            std::to_string(m_packedPixelSize) + "-byte pixels"));
+    }
+}
+
+unsigned char* BufferSink::packedRowTarget(uint32_t row) {
+    return m_writer.rowTarget(row);
+}
+
+void BufferSink::writePacked(uint32_t row, const unsigned char* pixels) {
+    // pixels are usually already in place, see `packedRowTarget`
+    m_writer.writeRow(row, pixels);
+}
+
+
+} // namespace png_decoder::sink
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "misc/orientation.h"
+#include "misc/pixel_format.h"
+#include "image-view/image_view.h"
+#include "orientation/oriented_writer.h"
+#include "image.h"
+
+
+namespace png_decoder::sink {
+
+/*
+* Consumer of decoded rows. The decoder calls `begin` once, then `write` for every
+* row in top to bottom order as soon as the row is decoded, and finally `end`.
+* Neither the decoder nor the sink has to keep the whole image in memory.
+*
+* Sinks returning true from `acceptsConcurrentRows` may receive rows in any order
+* and from several threads at once (each row exactly once).
+*
+* Sinks returning true from `acceptsPackedRows` receive rows through `writePacked` instead of `write`:
+* pixels in `DecodeOptions::pixelFormat` (passed to `setPackedFormat` before `begin`), converted straight
+* from the defiltered scanline. If `packedRowTarget` returns memory for the row, pixels are converted right into it.
+*/
+class RowSink {
+public:
+    virtual ~RowSink() = default;
+
+    virtual void begin(uint32_t width, uint32_t height) = 0;
+    virtual void write(uint32_t row, const std::vector<RGB>& pixels) = 0;
+    virtual void end() = 0;
+
+    virtual bool acceptsConcurrentRows() const;
+    virtual bool acceptsPackedRows() const;
+    virtual void setPackedFormat(const PixelFormat& format);
+    virtual unsigned char* packedRowTarget(uint32_t row);
+    virtual void writePacked(uint32_t row, const unsigned char* pixels);
+};
+
+
+// fills an in-memory image, upright if the stored image has the given orientation
+class ImageSink : public RowSink {
+public:
+    explicit ImageSink(Image& image, Orientation orientation = Orientation::TopLeft);
+
+    void begin(uint32_t width, uint32_t height) override;
+    void write(uint32_t row, const std::vector<RGB>& pixels) override;
+    void end() override;
+
+    bool acceptsConcurrentRows() const override;
+
+private:
+    Image& m_image;
+    orientation::OrientedWriter m_writer;
+};
+
+
+// base class for sinks serializing rows of bytes into an output stream
+class StreamSink : public RowSink {
+public:
+    explicit StreamSink(std::ostream& stream);
+
+    void end() override;
+
+protected:
+    void writeBytes(const std::vector<unsigned char>& bytes);
+
+protected:
+    std::ostream& m_stream;
+    std::vector<unsigned char> m_row;
+};
+
+
+/*
+* Binary PPM (P6). See: https://netpbm.sourceforge.net/doc/ppm.html
+* Alpha channel is dropped.
+*/
+class PPMSink : public StreamSink {
+public:
+    explicit PPMSink(std::ostream& stream);
+
+    void begin(uint32_t width, uint32_t height) override;
+    void write(uint32_t row, const std::vector<RGB>& pixels) override;
+};
+
+
+/*
+* PAM (P7) with RGB_ALPHA tuple type. See: https://netpbm.sourceforge.net/doc/pam.html
+*/
+class PAMSink : public StreamSink {
+public:
+    explicit PAMSink(std::ostream& stream);
+
+    void begin(uint32_t width, uint32_t height) override;
+    void write(uint32_t row, const std::vector<RGB>& pixels) override;
+};
+
+
+// headerless 8-bit rows of four channels, RGBA unless `DecodeOptions::pixelFormat` says otherwise
+class RawRGBASink : public StreamSink {
+public:
+    explicit RawRGBASink(std::ostream& stream);
+
+    void begin(uint32_t width, uint32_t height) override;
+    void write(uint32_t row, const std::vector<RGB>& pixels) override;
+
+    bool acceptsPackedRows() const override;
+    void setPackedFormat(const PixelFormat& format) override;
+    void writePacked(uint32_t row, const unsigned char* pixels) override;
+
+private:
+    size_t m_packedPixelSize;
+};
+
+
+/*
+* Packed rows written into memory owned by the caller (e.g. a mapped texture), `stride` bytes apart.
+* Buffer must hold `(height - 1) * stride` bytes plus a packed row, and `stride` must not be less than the packed row.
+* A view limits rows to its width and requires packed pixels of its pixel size.
+* With an orientation the buffer receives the upright image, so width and height swap for transposing orientations.
+*/
+class BufferSink : public RowSink {
+public:
+    BufferSink(unsigned char* buffer, size_t size, size_t stride, Orientation orientation = Orientation::TopLeft);
+    explicit BufferSink(const image_view::ImageView& view, Orientation orientation = Orientation::TopLeft);
+
+    void begin(uint32_t width, uint32_t height) override;
+    void write(uint32_t row, const std::vector<RGB>& pixels) override;
+    void end() override;
+
+    bool acceptsConcurrentRows() const override;
+    bool acceptsPackedRows() const override;
+    void setPackedFormat(const PixelFormat& format) override;
+    unsigned char* packedRowTarget(uint32_t row) override;
+    void writePacked(uint32_t row, const unsigned char* pixels) override;
+
+private:
+    unsigned char* m_buffer;
+    size_t m_size;
+    size_t m_stride;
+    // longest row which fits, up to the stride for plain buffers
+    size_t m_rowCapacity;
+    // pixel size required by the view, 0 for plain buffers
+    size_t m_requiredPixelSize;
+    size_t m_packedPixelSize;
+    orientation::OrientedWriter m_writer;
+};
+
+
+} // namespace png_decoder::sink
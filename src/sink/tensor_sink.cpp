@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "tensor_sink.h"
+#include "exceptions/exceptions.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+
+namespace png_decoder::sink {
+
+namespace {
+
+// round to nearest even, overflow to infinity, see: https://en.wikipedia.org/wiki/Half-precision_floating-point_format
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t floatExponent = (bits >> 23) & 0xFF;
+    const int32_t exponent = int32_t(floatExponent) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (floatExponent == 0xFF) {
+        // infinity or NaN
+        return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+    }
+    if (exponent >= 31) {
+        return sign | 0x7C00;
+    }
+
+    uint32_t shift = 13;
+    uint32_t half = 0;
+    if (exponent <= 0) {
+        // subnormal half
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        half = mantissa >> shift;
+    }
+    else {
+        half = (uint32_t(exponent) << 10) | (mantissa >> shift);
+    }
+
+    // carry from mantissa into exponent is the correct result of rounding
+    const uint32_t remainder = mantissa & ((1U << shift) - 1);
+    const uint32_t halfway = 1U << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1))) {
+        ++half;
+    }
+    return sign | half;
+}
+
+void convertToHalf(const float* values, size_t count, uint16_t* out) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 4 <= count; i += 4) {
+        const __m128i halves = _mm_cvtps_ph(_mm_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), halves);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = floatToHalf(values[i]);
+    }
+}
+
+
+// `channelsCount` elements per pixel written contiguously
+void normalizeInterleaved(const unsigned char* rgba, size_t count, uint32_t channelsCount,
+                          const float* scale, const float* bias, float* out) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 scaleVector = _mm_loadu_ps(scale);
+    const __m128 biasVector = _mm_loadu_ps(bias);
+    const __m128i zero = _mm_setzero_si128();
+
+    // the last pixel is left for the scalar loop: with 3 channels every store spills into the next pixel
+    for (; i + 1 < count; ++i) {
+        uint32_t pixel;
+        std::memcpy(&pixel, rgba + 4 * i, sizeof(pixel));
+        const __m128i samples = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero);
+        const __m128 values = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(samples), scaleVector), biasVector);
+        _mm_storeu_ps(out + channelsCount * i, values);
+    }
+#endif
+    for (; i < count; ++i) {
+        for (uint32_t c = 0; c < channelsCount; ++c) {
+            out[channelsCount * i + c] = rgba[4 * i + c] * scale[c] + bias[c];
+        }
+    }
+}
+
+
+// every channel written into its own plane
+void normalizePlanar(const unsigned char* rgba, size_t count, uint32_t channelsCount,
+                     const float* scale, const float* bias, float* const* planes) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 4 * i));
+        for (uint32_t c = 0; c < channelsCount; ++c) {
+            // pixels are little-endian 32-bit lanes: R | G << 8 | B << 16 | A << 24
+            const __m128i samples = _mm_and_si128(_mm_srli_epi32(pixels, 8 * c), byteMask);
+            const __m128 values = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(samples), _mm_set1_ps(scale[c])), _mm_set1_ps(bias[c]));
+            _mm_storeu_ps(planes[c] + i, values);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        for (uint32_t c = 0; c < channelsCount; ++c) {
+            planes[c][i] = rgba[4 * i + c] * scale[c] + bias[c];
+        }
+    }
+}
+
+} // namespace
+
+
+TensorSink::TensorSink(void* buffer, size_t size, TensorOptions options)
+    : m_buffer{static_cast<unsigned char*>(buffer)}
+    , m_size{size}
+    , m_options{options}
+    , m_width{0}
+    , m_height{0}
+    , m_scale{}
+    , m_bias{}
+    {
+        if (m_options.channelsCount != 3 && m_options.channelsCount != 4) {
+            throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE(
+                "Unsupported tensor channels count: " + std::to_string(m_options.channelsCount)));
+        }
+
+        for (size_t c = 0; c < m_scale.size(); ++c) {
+            if (m_options.std[c] == 0.0f) {
+                throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("Tensor std must not be zero"));
+            }
+            // (sample / 255 - mean) / std
+            m_scale[c] = 1.0f / (255.0f * m_options.std[c]);
+            m_bias[c] = -m_options.mean[c] / m_options.std[c];
+        }
+    }
+
+
+void TensorSink::begin(uint32_t width, uint32_t height) {
+    const size_t required = size_t(m_options.channelsCount) * width * height * elementSize();
+    if (required > m_size) {
+        throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE(
+            "Tensor buffer of " + std::to_string(m_size) + " bytes cannot hold " + std::to_string(required) + " bytes"));
+    }
+    m_width = width;
+    m_height = height;
+}
+
+
+void TensorSink::write(uint32_t row, const std::vector<RGB>& pixels) {
+    std::vector<unsigned char> rgba(PACKED_PIXEL_SIZE * pixels.size());
+    packPixels(pixels, PixelFormat{}, rgba.data());
+    writePacked(row, rgba.data());
+}
+
+
+void TensorSink::end() {}
+
+
+bool TensorSink::acceptsConcurrentRows() const {
+    // rows are disjoint parts of the tensor in both layouts
+    return true;
+}
+
+
+bool TensorSink::acceptsPackedRows() const {
+    return true;
+}
+
+
+void TensorSink::setPackedFormat(const PixelFormat& format) {
+    if (format.channelOrder != ChannelOrder::RGBA || !isEncoded8Bit(format)) {
+        throw exceptions::SinkException(PNG_DECODER_ERROR_MESSAGE("Tensor sink requires 8-bit RGBA packed rows"));
+    }
+}
+
+
+void TensorSink::writePacked(uint32_t row, const unsigned char* pixels) {
+    if (m_options.elementType == TensorElementType::Float32) {
+        writeFloat32(row, pixels);
+    }
+    else {
+        writeFloat16(row, pixels);
+    }
+}
+
+
+size_t TensorSink::elementSize() const {
+    return m_options.elementType == TensorElementType::Float32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+
+void TensorSink::writeFloat32(uint32_t row, const unsigned char* pixels) {
+    float* tensor = reinterpret_cast<float*>(m_buffer);
+    const size_t planeSize = size_t(m_width) * m_height;
+
+    if (m_options.layout == TensorLayout::HWC) {
+        float* out = tensor + size_t(row) * m_width * m_options.channelsCount;
+        normalizeInterleaved(pixels, m_width, m_options.channelsCount, m_scale.data(), m_bias.data(), out);
+    }
+    else {
+        float* planes[4];
+        for (uint32_t c = 0; c < m_options.channelsCount; ++c) {
+            planes[c] = tensor + c * planeSize + size_t(row) * m_width;
+        }
+        normalizePlanar(pixels, m_width, m_options.channelsCount, m_scale.data(), m_bias.data(), planes);
+    }
+}
+
+
+void TensorSink::writeFloat16(uint32_t row, const unsigned char* pixels) {
+    uint16_t* tensor = reinterpret_cast<uint16_t*>(m_buffer);
+    const size_t planeSize = size_t(m_width) * m_height;
+    const uint32_t channelsCount = m_options.channelsCount;
+
+    // normalizing a block of pixels into floats on the stack, then narrowing them into the tensor
+    float block[4 * BLOCK_PIXELS];
+    for (size_t first = 0; first < m_width; first += BLOCK_PIXELS) {
+        const size_t count = std::min<size_t>(BLOCK_PIXELS, m_width - first);
+        const unsigned char* rgba = pixels + PACKED_PIXEL_SIZE * first;
+
+        if (m_options.layout == TensorLayout::HWC) {
+            normalizeInterleaved(rgba, count, channelsCount, m_scale.data(), m_bias.data(), block);
+            uint16_t* out = tensor + (size_t(row) * m_width + first) * channelsCount;
+            convertToHalf(block, count * channelsCount, out);
+        }
+        else {
+            float* planes[4];
+            for (uint32_t c = 0; c < channelsCount; ++c) {
+                planes[c] = block + c * BLOCK_PIXELS;
+            }
+            normalizePlanar(rgba, count, channelsCount, m_scale.data(), m_bias.data(), planes);
+            for (uint32_t c = 0; c < channelsCount; ++c) {
+                uint16_t* out = tensor + c * planeSize + size_t(row) * m_width + first;
+                convertToHalf(planes[c], count, out);
+            }
+        }
+    }
+}
+
+
+} // namespace png_decoder::sink
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sink.h"
+
+
+namespace png_decoder::sink {
+
+enum class TensorLayout : uint8_t {
+    // height x width x channels
+    HWC = 0,
+    // channels x height x width
+    CHW,
+};
+
+enum class TensorElementType : uint8_t {
+    Float32 = 0,
+    // IEEE 754 half precision, stored as uint16_t
+    Float16,
+};
+
+struct TensorOptions {
+    TensorLayout layout = TensorLayout::HWC;
+    TensorElementType elementType = TensorElementType::Float32;
+    // 3 drops alpha, 4 keeps it
+    uint32_t channelsCount = 3;
+    // every element is (sample / 255 - mean[c]) / std[c], channels in RGBA order
+    std::array<float, 4> mean{0.0f, 0.0f, 0.0f, 0.0f};
+    std::array<float, 4> std{1.0f, 1.0f, 1.0f, 1.0f};
+};
+
+
+/*
+* Writes normalized float tensor into a buffer owned by the caller (e.g. a pinned batch slot of a data loader).
+* Scaling, normalization and the layout transposition are fused into conversion of each packed 8-bit row,
+* so neither an `Image` nor a temporary float image is created.
+* Buffer must hold `channelsCount * width * height` elements and be aligned for the element type.
+* Requires the default 8-bit RGBA `DecodeOptions::pixelFormat` (straight or premultiplied alpha).
+*/
+class TensorSink : public RowSink {
+public:
+    TensorSink(void* buffer, size_t size, TensorOptions options = {});
+
+    void begin(uint32_t width, uint32_t height) override;
+    void write(uint32_t row, const std::vector<RGB>& pixels) override;
+    void end() override;
+
+    bool acceptsConcurrentRows() const override;
+    bool acceptsPackedRows() const override;
+    void setPackedFormat(const PixelFormat& format) override;
+    void writePacked(uint32_t row, const unsigned char* pixels) override;
+
+private:
+    size_t elementSize() const;
+    void writeFloat32(uint32_t row, const unsigned char* pixels);
+    void writeFloat16(uint32_t row, const unsigned char* pixels);
+
+private:
+    // pixels converted at once when the tensor is written through a temporary buffer
+    static constexpr size_t BLOCK_PIXELS = 64;
+
+private:
+    unsigned char* m_buffer;
+    size_t m_size;
+    TensorOptions m_options;
+    uint32_t m_width;
+    uint32_t m_height;
+    // element = sample * scale + bias
+    std::array<float, 4> m_scale;
+    std::array<float, 4> m_bias;
+};
+
+
+} // namespace png_decoder::sink
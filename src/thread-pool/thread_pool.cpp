@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <memory>
+
+#include "thread_pool.h"
+
+
+namespace png_decoder::thread_pool {
+
+ThreadPool::ThreadPool(size_t threadsCount)
+    : m_mutex{}
+    , m_condition{}
+    , m_tasks{}
+    , m_stopped{false}
+    , m_threads{}
+    {
+        threadsCount = std::max<size_t>(1, threadsCount);
+        m_threads.reserve(threadsCount);
+        for (size_t i = 0; i < threadsCount; ++i) {
+            m_threads.emplace_back([this]() { work(); });
+        }
+    }
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+
+void ThreadPool::submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+size_t ThreadPool::threadsCount() const noexcept {
+    return m_threads.size();
+}
+
+
+void ThreadPool::work() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopped || !m_tasks.empty(); });
+
+            // draining the queue before stopping
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+
+void runParallel(ThreadPool& pool, size_t tasksCount, const std::function<void(size_t)>& task) {
+    std::vector<std::future<void>> results;
+    results.reserve(tasksCount);
+
+    for (size_t i = 0; i < tasksCount; ++i) {
+        auto promise = std::make_shared<std::promise<void>>();
+        results.push_back(promise->get_future());
+
+        pool.submit([promise, &task, i]() {
+            try {
+                task(i);
+                promise->set_value();
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+    }
+
+    std::exception_ptr error = nullptr;
+    for (auto& result : results) {
+        try {
+            result.get();
+        }
+        catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
+} // namespace png_decoder::thread_pool
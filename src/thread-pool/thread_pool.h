@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace png_decoder::thread_pool {
+
+/*
+* Fixed-size pool of worker threads executing tasks in FIFO order.
+* Destructor waits until all submitted tasks are finished.
+* Tasks must not throw: an exception escaping a task terminates the process (`runParallel` catches them).
+*/
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(size_t threadsCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+    size_t threadsCount() const noexcept;
+
+private:
+    void work();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Task> m_tasks;
+    bool m_stopped;
+    std::vector<std::thread> m_threads;
+};
+
+
+/*
+* Runs `task(0)`, ..., `task(tasksCount - 1)` on the pool and waits for all of them.
+* The first exception thrown by a task is rethrown after every task has finished.
+*/
+void runParallel(ThreadPool& pool, size_t tasksCount, const std::function<void(size_t)>& task);
+
+
+} // namespace png_decoder::thread_pool
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstring>
+
+#include "hash.h"
+
+
+namespace png_decoder::utils {
+
+namespace {
+
+constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotateLeft(uint64_t value, uint32_t bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// the specification reads input as little-endian integers
+inline uint64_t readLittleEndian64(const unsigned char* bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(value); ++i) {
+        value |= uint64_t(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+inline uint32_t readLittleEndian32(const unsigned char* bytes) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < sizeof(value); ++i) {
+        value |= uint32_t(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+
+XXHash64::XXHash64(uint64_t seed)
+    : m_seed{seed}
+    , m_accumulators{seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1}
+    , m_totalSize{0}
+    , m_buffer{}
+    , m_bufferSize{0} {}
+
+
+void XXHash64::update(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    m_totalSize += size;
+
+    // completing the stripe left from the previous call
+    if (m_bufferSize > 0) {
+        const size_t count = std::min(size, STRIPE_SIZE - m_bufferSize);
+        std::memcpy(m_buffer + m_bufferSize, bytes, count);
+        m_bufferSize += count;
+        bytes += count;
+        size -= count;
+
+        if (m_bufferSize < STRIPE_SIZE) {
+            return;
+        }
+        for (size_t lane = 0; lane < 4; ++lane) {
+            m_accumulators[lane] = round(m_accumulators[lane], readLittleEndian64(m_buffer + 8 * lane));
+        }
+        m_bufferSize = 0;
+    }
+
+    for (; size >= STRIPE_SIZE; bytes += STRIPE_SIZE, size -= STRIPE_SIZE) {
+        for (size_t lane = 0; lane < 4; ++lane) {
+            m_accumulators[lane] = round(m_accumulators[lane], readLittleEndian64(bytes + 8 * lane));
+        }
+    }
+
+    std::memcpy(m_buffer, bytes, size);
+    m_bufferSize = size;
+}
+
+
+uint64_t XXHash64::digest() const {
+    uint64_t hash = 0;
+    if (m_totalSize >= STRIPE_SIZE) {
+        hash = rotateLeft(m_accumulators[0], 1) + rotateLeft(m_accumulators[1], 7) +
+               rotateLeft(m_accumulators[2], 12) + rotateLeft(m_accumulators[3], 18);
+        for (size_t lane = 0; lane < 4; ++lane) {
+            hash = mergeRound(hash, m_accumulators[lane]);
+        }
+    }
+    else {
+        hash = m_seed + PRIME_5;
+    }
+    hash += m_totalSize;
+
+    const unsigned char* bytes = m_buffer;
+    size_t size = m_bufferSize;
+    for (; size >= 8; bytes += 8, size -= 8) {
+        hash ^= round(0, readLittleEndian64(bytes));
+        hash = rotateLeft(hash, 27) * PRIME_1 + PRIME_4;
+    }
+    if (size >= 4) {
+        hash ^= uint64_t(readLittleEndian32(bytes)) * PRIME_1;
+        hash = rotateLeft(hash, 23) * PRIME_2 + PRIME_3;
+        bytes += 4;
+        size -= 4;
+    }
+    for (; size > 0; ++bytes, --size) {
+        hash ^= (*bytes) * PRIME_5;
+        hash = rotateLeft(hash, 11) * PRIME_1;
+    }
+
+    // avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+uint64_t XXHash64::round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME_2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * PRIME_1;
+}
+
+
+uint64_t XXHash64::mergeRound(uint64_t hash, uint64_t accumulator) {
+    hash ^= round(0, accumulator);
+    return hash * PRIME_1 + PRIME_4;
+}
+
+} // namespace png_decoder::utils
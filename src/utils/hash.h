@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace png_decoder::utils {
+
+/*
+* XXH64 non-cryptographic hash, see: https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+* Fast enough to fingerprint whole files and pixel buffers; not suitable against adversarial collisions.
+* Data may be passed in any number of `update` calls, the digest does not depend on how it was split.
+*/
+class XXHash64 {
+public:
+    explicit XXHash64(uint64_t seed = 0);
+
+    void update(const void* data, size_t size);
+    uint64_t digest() const;
+
+private:
+    static uint64_t round(uint64_t accumulator, uint64_t input);
+    static uint64_t mergeRound(uint64_t hash, uint64_t accumulator);
+
+private:
+    static constexpr size_t STRIPE_SIZE = 32;
+
+private:
+    uint64_t m_seed;
+    uint64_t m_accumulators[4];
+    uint64_t m_totalSize;
+    // tail of the data not forming a complete stripe yet
+    unsigned char m_buffer[STRIPE_SIZE];
+    size_t m_bufferSize;
+};
+
+
+inline uint64_t xxHash64(const void* data, size_t size, uint64_t seed = 0) {
+    XXHash64 hash(seed);
+    hash.update(data, size);
+    return hash.digest();
+}
+
+} // namespace png_decoder::utils
@@ -0,0 +1,55 @@
+#include "memory_stream.h"
+
+
+namespace png_decoder::utils {
+
+MemoryStreamBuffer::MemoryStreamBuffer(const char* data, size_t size) {
+    // std::streambuf API requires non-const pointers, the buffer is never written though
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+}
+
+const char* MemoryStreamBuffer::current() const {
+    return gptr();
+}
+
+size_t MemoryStreamBuffer::available() const {
+    return egptr() - gptr();
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekoff(
+        off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode) {
+    if (!(mode & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+
+    off_type base = 0;
+    if (direction == std::ios_base::cur) {
+        base = gptr() - eback();
+    }
+    else if (direction == std::ios_base::end) {
+        base = egptr() - eback();
+    }
+
+    off_type target = base + offset;
+    if (target < 0 || target > egptr() - eback()) {
+        return pos_type(off_type(-1));
+    }
+
+    setg(eback(), eback() + target, egptr());
+    return pos_type(target);
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekpos(pos_type position, std::ios_base::openmode mode) {
+    return seekoff(off_type(position), std::ios_base::beg, mode);
+}
+
+
+MemoryInputStream::MemoryInputStream(const char* data, size_t size)
+    : std::istream(nullptr)
+    , m_buffer(data, size)
+    {
+        rdbuf(&m_buffer);
+    }
+
+} // namespace png_decoder::utils
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+
+
+namespace png_decoder::utils {
+
+// read-only, seekable stream buffer over memory owned by the caller (no copy is made)
+class MemoryStreamBuffer : public std::streambuf {
+public:
+    MemoryStreamBuffer(const char* data, size_t size);
+
+    // unread part of the buffer, lets readers look at the data without copying it
+    const char* current() const;
+    size_t available() const;
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode) override;
+    pos_type seekpos(pos_type position, std::ios_base::openmode mode) override;
+};
+
+
+class MemoryInputStream : public std::istream {
+public:
+    MemoryInputStream(const char* data, size_t size);
+
+private:
+    MemoryStreamBuffer m_buffer;
+};
+
+} // namespace png_decoder::utils
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <cstdint>
+#include <cstring>
+#include <istream>
 #include <string>
 
 #include "exceptions/exceptions.h"
@@ -8,34 +11,27 @@
 
 namespace png_decoder::utils {
 
+/*
+* Network byte order is big-endian, so `ntohl` and `ntohs` convert on any host without detecting its endianness
+* at run time, and the helpers keep no state: they are safe to call from any number of threads.
+*/
 inline uint64_t convertFromBigEndianToHostEndianness(uint64_t x) {
-    static bool areEndiannessesSame = (1 == ntohl(1));
-
-    return (
-        areEndiannessesSame
-        ? x
-        : ((uint64_t)ntohl((x) & 0xFFFFFFFF) << 32) | ntohl((x) >> 32)
-    );
+    // the half stored first in memory is the more significant one of a big-endian value
+    uint32_t halves[2];
+    std::memcpy(halves, &x, sizeof(x));
+    return (static_cast<uint64_t>(ntohl(halves[0])) << 32) | ntohl(halves[1]);
 }
 
 inline uint32_t convertFromBigEndianToHostEndianness(uint32_t x) {
-    static bool areEndiannessesSame = (1 == ntohl(1));
-
-    return (
-        areEndiannessesSame
-        ? x
-        : ((uint32_t)ntohs((x) & 0xFFFFFFFF) << 16) | ntohs((x) >> 16)
-    );
+    return ntohl(x);
 }
 
 inline uint32_t convertFromBigEndianToHostEndianness(uint16_t x) {
-    static bool areEndiannessesSame = (1 == ntohl(1));
+    return ntohs(x);
+}
 
-    return (
-        areEndiannessesSame
-        ? (x)
-        : (x << 8) | (x >> 8)
-    );
+inline uint32_t readBigEndianUInt32(const unsigned char* bytes) {
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
 }
 
 inline std::string stringifyChunkType(uint32_t chunkType) {
@@ -49,14 +45,16 @@ inline std::string stringifyChunkType(uint32_t chunkType) {
     return std::string(bytes);
 }
 
-// read bytes from stream as big-endian and convert the value from big-endian to the endianess of the host machine
+// read bytes from stream as big-endian and convert the value from big-endian to the endianess of the host machine,
+// returns false if the stream ends first
 template <class T>
-inline void readFromBigEndianAndConvertToHostEndianess(std::istream& stream, T* destination, size_t bytesCount, const std::string& errorMessage) {
+inline bool readFromBigEndianAndConvertToHostEndianess(std::istream& stream, T* destination, size_t bytesCount) {
     if (!stream.read(reinterpret_cast<char*>(destination), bytesCount)) {
-        throw exceptions::InvalidStreamException(errorMessage);
+        return false;
     }
 
     *destination = convertFromBigEndianToHostEndianness(*destination);
+    return true;
 }
 
 } // namespace png_decoder::utils
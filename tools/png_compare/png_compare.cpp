@@ -0,0 +1,398 @@
+/*
+* png_compare: runs png_decoder and libpng over a directory corpus, verifies that both
+* decoders produce identical pixels and reports throughput, latency percentiles and peak RSS.
+*
+* Usage: png_compare <corpus-dir> [--repeat N]
+*
+* Output is JSON Lines: one "file" record per image followed by one "summary" record per decoder.
+* Each decoder is measured in its own child process, so `peak_rss_kb` is not polluted by the other one.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <png.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "png_decoder.h"
+#include "image.h"
+
+
+namespace {
+
+namespace fs = std::filesystem;
+
+struct FileInfo {
+    std::string path;
+    uint64_t compressedBytes = 0;
+};
+
+struct DecoderRun {
+    // seconds per repeat per file, NaN if decoding failed
+    std::vector<std::vector<double>> latencies;
+    long peakRssKb = 0;
+};
+
+using DecodeFunction = Image (*)(const std::string& path);
+
+
+Image decodeWithPngDecoder(const std::string& path) {
+    return ReadPng(path);
+}
+
+/*
+* Decodes with libpng into the same `Image` representation png_decoder produces:
+* samples are not rescaled, grayscale is replicated into RGB, palette is expanded, missing alpha is 255.
+*/
+Image decodeWithLibpng(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        throw std::runtime_error("libpng: cannot open " + path);
+    }
+
+    // every object with a destructor is created before `setjmp`
+    Image image;
+    std::vector<png_byte> buffer;
+    std::vector<png_bytep> rows;
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png_create_info_struct(png);
+
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        std::fclose(file);
+        throw std::runtime_error("libpng: cannot decode " + path);
+    }
+
+    png_init_io(png, file);
+    png_read_info(png, info);
+
+    const int colorType = png_get_color_type(png, info);
+    png_set_packing(png);
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    const uint32_t width = png_get_image_width(png, info);
+    const uint32_t height = png_get_image_height(png, info);
+    const uint32_t channels = png_get_channels(png, info);
+    const size_t rowBytes = png_get_rowbytes(png, info);
+
+    buffer.resize(rowBytes * height);
+    rows.resize(height);
+    for (uint32_t y = 0; y < height; ++y) {
+        rows[y] = buffer.data() + rowBytes * y;
+    }
+    png_read_image(png, rows.data());
+
+    png_colorp palette = nullptr;
+    int paletteSize = 0;
+    if (colorType == PNG_COLOR_TYPE_PALETTE) {
+        png_get_PLTE(png, info, &palette, &paletteSize);
+    }
+
+    image.SetSize(height, width);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const png_bytep sample = rows[y] + x * channels;
+            RGB& pixel = image(y, x);
+            pixel.a = 255;
+
+            switch (colorType) {
+            case PNG_COLOR_TYPE_GRAY_ALPHA:
+                pixel.a = sample[1];
+                [[fallthrough]];
+            case PNG_COLOR_TYPE_GRAY:
+                pixel.r = pixel.g = pixel.b = sample[0];
+                break;
+            case PNG_COLOR_TYPE_PALETTE:
+                if (sample[0] < paletteSize) {
+                    pixel.r = palette[sample[0]].red;
+                    pixel.g = palette[sample[0]].green;
+                    pixel.b = palette[sample[0]].blue;
+                }
+                break;
+            case PNG_COLOR_TYPE_RGB_ALPHA:
+                pixel.a = sample[3];
+                [[fallthrough]];
+            default:
+                pixel.r = sample[0];
+                pixel.g = sample[1];
+                pixel.b = sample[2];
+                break;
+            }
+        }
+    }
+
+    png_destroy_read_struct(&png, &info, nullptr);
+    std::fclose(file);
+    return image;
+}
+
+
+std::vector<FileInfo> collectCorpus(const fs::path& directory) {
+    std::vector<FileInfo> files;
+    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".png") {
+            files.push_back(FileInfo{entry.path().string(), entry.file_size()});
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const FileInfo& lhs, const FileInfo& rhs) {
+        return lhs.path < rhs.path;
+    });
+    return files;
+}
+
+
+void writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written <= 0) {
+            std::_Exit(2);
+        }
+        bytes += written;
+        size -= written;
+    }
+}
+
+bool readAll(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t count = ::read(fd, bytes, size);
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+
+/*
+* Decodes the corpus `repeat` times per file in a forked child and collects the latencies over a pipe.
+* Peak RSS is taken from the child's resource usage.
+*/
+DecoderRun measure(DecodeFunction decode, const std::vector<FileInfo>& files, size_t repeat) {
+    int fds[2];
+    if (::pipe(fds) != 0) {
+        throw std::runtime_error("cannot create pipe");
+    }
+
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        throw std::runtime_error("cannot fork");
+    }
+
+    if (pid == 0) {
+        ::close(fds[0]);
+        for (const auto& file : files) {
+            for (size_t i = 0; i < repeat; ++i) {
+                double seconds = std::nan("");
+                try {
+                    auto start = std::chrono::steady_clock::now();
+                    Image image = decode(file.path);
+                    auto finish = std::chrono::steady_clock::now();
+                    seconds = std::chrono::duration<double>(finish - start).count();
+                }
+                catch (const std::exception&) {}
+                writeAll(fds[1], &seconds, sizeof(seconds));
+            }
+        }
+        ::close(fds[1]);
+        std::_Exit(0);
+    }
+
+    ::close(fds[1]);
+    DecoderRun run;
+    run.latencies.assign(files.size(), std::vector<double>(repeat, std::nan("")));
+    for (auto& fileLatencies : run.latencies) {
+        for (auto& seconds : fileLatencies) {
+            if (!readAll(fds[0], &seconds, sizeof(seconds))) {
+                break;
+            }
+        }
+    }
+    ::close(fds[0]);
+
+    int status = 0;
+    rusage usage{};
+    ::wait4(pid, &status, 0, &usage);
+    run.peakRssKb = usage.ru_maxrss;
+    return run;
+}
+
+
+std::string escapeJson(const std::string& value) {
+    std::string result;
+    for (char c : value) {
+        switch (c) {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        case '\t': result += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                result += buffer;
+            }
+            else {
+                result += c;
+            }
+        }
+    }
+    return result;
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+    return values[std::clamp<size_t>(index, 1, values.size()) - 1];
+}
+
+double median(std::vector<double> values) {
+    values.erase(std::remove_if(values.begin(), values.end(), [](double x) { return std::isnan(x); }), values.end());
+    return values.empty() ? std::nan("") : percentile(std::move(values), 50);
+}
+
+std::string formatNumber(double value) {
+    if (std::isnan(value)) {
+        return "null";
+    }
+    std::ostringstream out;
+    out.precision(6);
+    out << value;
+    return out.str();
+}
+
+
+void printSummary(const std::string& name, const DecoderRun& run, const std::vector<FileInfo>& files,
+                  const std::vector<uint64_t>& pixels) {
+    std::vector<double> samples;
+    double totalSeconds = 0;
+    double totalBytes = 0;
+    double totalPixels = 0;
+    size_t failures = 0;
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        bool failed = false;
+        for (double seconds : run.latencies[i]) {
+            if (std::isnan(seconds)) {
+                failed = true;
+                continue;
+            }
+            samples.push_back(seconds * 1000);
+            totalSeconds += seconds;
+            totalBytes += files[i].compressedBytes;
+            totalPixels += pixels[i];
+        }
+        failures += failed;
+    }
+
+    std::cout << "{\"type\":\"summary\",\"decoder\":\"" << name << "\""
+              << ",\"files\":" << files.size()
+              << ",\"failures\":" << failures
+              << ",\"compressed_mb_per_s\":" << formatNumber(totalSeconds > 0 ? totalBytes / 1e6 / totalSeconds : 0)
+              << ",\"megapixels_per_s\":" << formatNumber(totalSeconds > 0 ? totalPixels / 1e6 / totalSeconds : 0)
+              << ",\"latency_ms\":{"
+              << "\"p50\":" << formatNumber(percentile(samples, 50))
+              << ",\"p90\":" << formatNumber(percentile(samples, 90))
+              << ",\"p99\":" << formatNumber(percentile(samples, 99))
+              << ",\"max\":" << formatNumber(percentile(samples, 100))
+              << "}"
+              << ",\"peak_rss_kb\":" << run.peakRssKb
+              << "}\n";
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <corpus-dir> [--repeat N]\n";
+        return 1;
+    }
+
+    size_t repeat = 3;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+    }
+
+    const std::vector<FileInfo> files = collectCorpus(argv[1]);
+
+    // measuring first, while the parent process is still small
+    const DecoderRun ours = measure(&decodeWithPngDecoder, files, repeat);
+    const DecoderRun reference = measure(&decodeWithLibpng, files, repeat);
+
+    std::vector<uint64_t> pixels(files.size(), 0);
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        const FileInfo& file = files[i];
+        std::string error;
+        bool identical = false;
+        int32_t width = 0;
+        int32_t height = 0;
+
+        try {
+            Image expected = decodeWithLibpng(file.path);
+            width = expected.Width();
+            height = expected.Height();
+            pixels[i] = static_cast<uint64_t>(width) * height;
+
+            Image actual = decodeWithPngDecoder(file.path);
+            identical = actual.Width() == width && actual.Height() == height;
+            for (int32_t y = 0; identical && y < height; ++y) {
+                for (int32_t x = 0; x < width; ++x) {
+                    if (!(actual(y, x) == expected(y, x))) {
+                        identical = false;
+                        error = "first mismatch at row " + std::to_string(y) + ", col " + std::to_string(x);
+                        break;
+                    }
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+        mismatches += !identical;
+
+        std::cout << "{\"type\":\"file\",\"path\":\"" << escapeJson(file.path) << "\""
+                  << ",\"width\":" << width
+                  << ",\"height\":" << height
+                  << ",\"compressed_bytes\":" << file.compressedBytes
+                  << ",\"identical\":" << (identical ? "true" : "false")
+                  << ",\"png_decoder_ms\":" << formatNumber(median(ours.latencies[i]) * 1000)
+                  << ",\"libpng_ms\":" << formatNumber(median(reference.latencies[i]) * 1000);
+        if (!error.empty()) {
+            std::cout << ",\"error\":\"" << escapeJson(error) << "\"";
+        }
+        std::cout << "}\n";
+    }
+
+    printSummary("png_decoder", ours, files, pixels);
+    printSummary("libpng", reference, files, pixels);
+
+    return mismatches == 0 ? 0 : 3;
+}
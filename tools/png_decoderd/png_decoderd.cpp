@@ -0,0 +1,88 @@
+/*
+* png_decoderd: decode service shared by the processes of a host. Clients connect with
+* `png_decoder::daemon::DecodeClient`, pass PNG files as descriptors and map the decoded pixels
+* from sealed memfds, see `src/daemon/server.h`. Runs until SIGINT or SIGTERM.
+*
+* Usage: png_decoderd <socket-path> [--threads N] [--max-image-bytes N]
+*
+* --threads N           decoding threads shared by all clients (default: number of cores)
+* --max-image-bytes N   larger files and decoded images are refused (default 1 GiB)
+*
+* Access is controlled by the permissions of the socket file and its directory.
+*/
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <pthread.h>
+
+#include "daemon/server.h"
+
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <socket-path> [--threads N] [--max-image-bytes N]" << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::string socketPath = argv[1];
+    png_decoder::daemon::ServerOptions options{};
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threadsCount = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--max-image-bytes" && i + 1 < argc) {
+            options.maxImageBytes = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // blocked in every thread started from here on, the signals are only received by `sigwait` below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    try {
+        png_decoder::daemon::DecodeServer server(socketPath, options);
+
+        std::thread stopper([&server, &signals]() {
+            int signal = 0;
+            sigwait(&signals, &signal);
+            server.stop();
+        });
+
+        std::cerr << "png_decoderd: listening on " << socketPath << std::endl;
+        try {
+            server.run();
+        } catch (...) {
+            // wakes the stopper thread so that it can be joined
+            pthread_kill(stopper.native_handle(), SIGTERM);
+            stopper.join();
+            throw;
+        }
+        stopper.join();
+    } catch (const std::exception& e) {
+        std::cerr << "png_decoderd: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
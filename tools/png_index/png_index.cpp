@@ -0,0 +1,71 @@
+/*
+* png_index: builds a random access row index of a non-interlaced PNG and saves it into a sidecar file,
+* which `PNGDecoder::decodeRows` can later use to decode any range of rows without inflating
+* the image data from the beginning.
+*
+* Usage: png_index <image.png> [--rows N] [--output path]
+*
+* --rows N        minimal distance between checkpoints in rows (default 64)
+* --output path   sidecar file path (default <image.png>.idx)
+*/
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "png_decoder.h"
+
+
+namespace {
+
+constexpr uint32_t DEFAULT_ROWS_PER_CHECKPOINT = 64;
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <image.png> [--rows N] [--output path]" << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::string input = argv[1];
+    std::string output = input + ".idx";
+    uint32_t rowsPerCheckpoint = DEFAULT_ROWS_PER_CHECKPOINT;
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--rows" && i + 1 < argc) {
+            rowsPerCheckpoint = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    try {
+        std::ifstream file(input, std::ios::binary);
+        png_decoder::PNGDecoder decoder(file);
+        const png_decoder::row_index::RowIndex index = decoder.buildRowIndex(rowsPerCheckpoint);
+
+        std::ofstream sidecar(output, std::ios::binary);
+        index.save(sidecar);
+
+        std::cout << output << ": " << index.checkpoints.size() << " checkpoints for "
+                  << index.height << " rows" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << input << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
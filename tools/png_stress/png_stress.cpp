@@ -0,0 +1,259 @@
+/*
+* png_stress: decodes a directory corpus from 1 up to N concurrent threads, checks every decoded image against
+* a single-threaded reference and reports how throughput scales with the number of threads.
+*
+* Usage: png_stress <corpus-dir> [--threads N] [--repeat R] [--decode-threads M]
+*
+* --threads N          largest number of threads, runs use 1, 2, 4, ... and N threads (default: hardware concurrency)
+* --repeat R           passes over the corpus made by every thread of a run (default 2)
+* --decode-threads M   `DecodeOptions::threadsCount` of every decoding, nests pools of segmented images (default 1)
+*
+* Files are read into memory up front, so only the library is measured. Every thread alternates between
+* parsing its own decoder and decoding the shared, already parsed decoders of the corpus concurrently with the other threads.
+* Output is JSON Lines: one "run" record per thread count. Built with `-DPNG_DECODER_SANITIZER=thread`,
+* the tool doubles as the data race check of the library.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "png_decoder.h"
+#include "image-view/image_view.h"
+#include "utils/hash.h"
+#include "utils/memory_stream.h"
+
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr size_t DEFAULT_REPEAT = 2;
+
+struct CorpusFile {
+    std::string path;
+    std::vector<char> bytes;
+    // parsed once and shared by all threads
+    std::unique_ptr<png_decoder::PNGDecoder> decoder;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // XXH64 of the packed pixels decoded on one thread
+    uint64_t pixelsHash = 0;
+};
+
+struct RunResult {
+    size_t threads = 0;
+    uint64_t decodes = 0;
+    uint64_t pixels = 0;
+    uint64_t mismatches = 0;
+    uint64_t failures = 0;
+    double seconds = 0;
+};
+
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <corpus-dir> [--threads N] [--repeat R] [--decode-threads M]" << std::endl;
+}
+
+std::vector<CorpusFile> loadCorpus(const fs::path& directory) {
+    std::vector<std::string> paths;
+    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (entry.is_regular_file() && extension == ".png") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<CorpusFile> files;
+    for (const auto& path : paths) {
+        std::ifstream stream(path, std::ios::binary);
+        CorpusFile file;
+        file.path = path;
+        file.bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        files.push_back(std::move(file));
+    }
+    return files;
+}
+
+// decodes packed RGBA pixels into `buffer` and hashes them
+uint64_t decodeAndHash(const png_decoder::PNGDecoder& decoder, std::vector<unsigned char>& buffer) {
+    const uint32_t width = decoder.getIHDR().width;
+    const uint32_t height = decoder.getIHDR().height;
+    const size_t stride = png_decoder::PACKED_PIXEL_SIZE * static_cast<size_t>(width);
+    buffer.resize(stride * height);
+    decoder.decode(png_decoder::image_view::ImageView(buffer.data(), width, height, stride));
+
+    png_decoder::utils::XXHash64 hash;
+    hash.update(buffer.data(), buffer.size());
+    return hash.digest();
+}
+
+// parses every file and records its reference hash on this thread, unreadable files are dropped
+void prepareReferences(std::vector<CorpusFile>& files, const png_decoder::DecodeOptions& options) {
+    std::vector<unsigned char> buffer;
+    std::vector<CorpusFile> valid;
+    for (auto& file : files) {
+        try {
+            png_decoder::utils::MemoryInputStream stream(file.bytes.data(), file.bytes.size());
+            file.decoder = std::make_unique<png_decoder::PNGDecoder>(stream, options);
+            file.width = file.decoder->getIHDR().width;
+            file.height = file.decoder->getIHDR().height;
+            file.pixelsHash = decodeAndHash(*file.decoder, buffer);
+            valid.push_back(std::move(file));
+        }
+        catch (const std::exception& e) {
+            std::cerr << "skipping " << file.path << ": " << e.what() << std::endl;
+        }
+    }
+    files = std::move(valid);
+}
+
+/*
+* Every thread makes `repeat` passes over the corpus starting at its own offset, so different threads decode
+* different images at the same time, and the same shared decoder is used by several threads over the run.
+*/
+RunResult run(const std::vector<CorpusFile>& files, const png_decoder::DecodeOptions& options,
+              size_t threadsCount, size_t repeat) {
+    std::atomic<uint64_t> decodes{0};
+    std::atomic<uint64_t> pixels{0};
+    std::atomic<uint64_t> mismatches{0};
+    std::atomic<uint64_t> failures{0};
+
+    auto work = [&](size_t threadIndex) {
+        std::vector<unsigned char> buffer;
+        const size_t total = repeat * files.size();
+        for (size_t i = 0; i < total; ++i) {
+            const size_t index = (threadIndex * files.size() / threadsCount + i) % files.size();
+            const CorpusFile& file = files[index];
+            try {
+                uint64_t hash = 0;
+                if (i % 2 == 0) {
+                    png_decoder::utils::MemoryInputStream stream(file.bytes.data(), file.bytes.size());
+                    const png_decoder::PNGDecoder decoder(stream, options);
+                    hash = decodeAndHash(decoder, buffer);
+                }
+                else {
+                    hash = decodeAndHash(*file.decoder, buffer);
+                }
+                if (hash != file.pixelsHash) {
+                    mismatches.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            catch (const std::exception&) {
+                failures.fetch_add(1, std::memory_order_relaxed);
+            }
+            decodes.fetch_add(1, std::memory_order_relaxed);
+            pixels.fetch_add(static_cast<uint64_t>(file.width) * file.height, std::memory_order_relaxed);
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(threadsCount);
+    for (size_t i = 0; i < threadsCount; ++i) {
+        threads.emplace_back(work, i);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const auto finish = std::chrono::steady_clock::now();
+
+    RunResult result;
+    result.threads = threadsCount;
+    result.decodes = decodes.load();
+    result.pixels = pixels.load();
+    result.mismatches = mismatches.load();
+    result.failures = failures.load();
+    result.seconds = std::chrono::duration<double>(finish - start).count();
+    return result;
+}
+
+std::vector<size_t> threadCounts(size_t maxThreads) {
+    std::vector<size_t> counts;
+    for (size_t count = 1; count < maxThreads; count *= 2) {
+        counts.push_back(count);
+    }
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+std::string formatNumber(double value) {
+    std::ostringstream out;
+    out.precision(6);
+    out << value;
+    return out.str();
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t repeat = DEFAULT_REPEAT;
+    png_decoder::DecodeOptions options;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            maxThreads = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--decode-threads") == 0 && i + 1 < argc) {
+            options.threadsCount = std::max(1, std::atoi(argv[++i]));
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<CorpusFile> files = loadCorpus(argv[1]);
+    prepareReferences(files, options);
+    if (files.empty()) {
+        std::cerr << "No decodable PNG files in " << argv[1] << std::endl;
+        return 1;
+    }
+
+    uint64_t errors = 0;
+    double baseThroughput = 0;
+    for (size_t threadsCount : threadCounts(maxThreads)) {
+        const RunResult result = run(files, options, threadsCount, repeat);
+        const double throughput = result.seconds > 0 ? result.pixels / 1e6 / result.seconds : 0;
+        if (threadsCount == 1) {
+            baseThroughput = throughput;
+        }
+        const double speedup = baseThroughput > 0 ? throughput / baseThroughput : 0;
+        errors += result.mismatches + result.failures;
+
+        std::cout << "{\"type\":\"run\",\"threads\":" << result.threads
+                  << ",\"decodes\":" << result.decodes
+                  << ",\"seconds\":" << formatNumber(result.seconds)
+                  << ",\"megapixels_per_s\":" << formatNumber(throughput)
+                  << ",\"speedup\":" << formatNumber(speedup)
+                  << ",\"efficiency\":" << formatNumber(speedup / threadsCount)
+                  << ",\"mismatches\":" << result.mismatches
+                  << ",\"failures\":" << result.failures
+                  << "}" << std::endl;
+    }
+
+    return errors == 0 ? 0 : 3;
+}